@@ -1,34 +1,36 @@
 #include <iostream>
 #include <vector>
-#include <future>
 #include <chrono>
+#include <cerrno>
+#include <cctype>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <algorithm>
-#include <mutex>
+#include <memory>
+#include <random>
+
+#include "primality.h"
+#include "prime_count.h"
+#include "prime_sieve.h"
+#include "prime_stream.h"
+#include "work_stealing.h"
 
 using namespace std;
 using namespace chrono;
 
-mutex prime_count_mutex;  // Mutex for thread-safe access to prime_count
-
+// Deterministic for every 64-bit n: small-prime filter, then Miller-Rabin
+// in Montgomery form (primality.h).
 bool isPrime(unsigned long long n) {
-    if (n <= 1) return false;
-    if (n <= 3) return true;
-    if (n % 2 == 0 || n % 3 == 0) return false;
-    for (unsigned long long i = 5; i * i <= n; i += 6) {
-        if (n % i == 0 || n % (i + 2) == 0) return false;
-    }
-    return true;
+    return isPrime64(n);
 }
 
-int segmentedSieveCount(unsigned long long start, unsigned long long end) {
-    int count = 0;
-    for (unsigned long long i = start; i < end; ++i) {
-        if (isPrime(i)) {
-            ++count;
-        }
-    }
-    return count;
+// Primes in [start, end), by segmented sieve (prime_sieve.h). basePrimes
+// must hold the odd primes up to sqrt(end).
+uint64_t segmentedSieveCount(const vector<uint32_t>& basePrimes, unsigned long long start, unsigned long long end) {
+    SegmentedSieve sieve(basePrimes);
+    return sieve.count(start, end);
 }
 
 string formatTime(long long duration) {
@@ -46,28 +48,334 @@ string formatTime(long long duration) {
     return formattedTime;
 }
 
-int main() {
-    const unsigned long long limit = 1000000000; // upto 1 billion
-    const int num_threads = thread::hardware_concurrency();
-    vector<future<int>> futures;
-    int prime_count = 0;  // Shared variable for prime count
+// Per-worker prime count, padded so that workers counting at the same time
+// do not share a cache line.
+struct WorkerCount {
+    uint64_t primes;
+    char pad[56];
+};
 
-    auto start_time = high_resolution_clock::now();
+// Primes in [first, limit) on the first `workers` workers of the pool. The
+// range is cut into about 64 chunks per pool worker so that stealing can
+// even out the load; each worker reuses one sieve for all the chunks it
+// runs.
+uint64_t parallelSieveCount(WorkStealingPool& pool, unsigned workers, const vector<uint32_t>& basePrimes,
+                            unsigned long long limit, unsigned long long first = 0) {
+    const uint64_t chunkSize = max<uint64_t>((limit - first) / (pool.size() * 64ULL) + 1, 1 << 21);
+    const uint64_t chunks = (limit - first) / chunkSize + ((limit - first) % chunkSize != 0);
+    vector<WorkerCount> counts(pool.size(), WorkerCount());
+    vector<unique_ptr<SegmentedSieve>> sieves(pool.size());
+    pool.run(chunks, [&](unsigned w, uint64_t chunk) {
+        if (!sieves[w])
+            sieves[w].reset(new SegmentedSieve(basePrimes));
+        uint64_t start = first + chunk * chunkSize;
+        uint64_t end = limit - start > chunkSize ? start + chunkSize : limit;
+        counts[w].primes += sieves[w]->count(start, end);
+    }, workers);
+
+    uint64_t total = 0;
+    for (size_t w = 0; w < counts.size(); ++w)
+        total += counts[w].primes;
+    return total;
+}
+
+// Strong scaling: the same count on 1..N workers (powers of two and N
+// itself above 16), with the speedup and efficiency against one worker.
+// The chunking depends only on the pool size, so every row does the same
+// work.
+void scalingReport(WorkStealingPool& pool, const vector<uint32_t>& basePrimes, unsigned long long limit) {
+    vector<unsigned> steps;
+    for (unsigned t = 1; t <= pool.size(); t = pool.size() <= 16 ? t + 1 : t * 2)
+        steps.push_back(t);
+    if (steps.back() != pool.size())
+        steps.push_back(pool.size());
+
+    parallelSieveCount(pool, 0, basePrimes, limit); // warm-up: page in the sieves and base primes
+    printf("%8s %12s %10s %11s %10s %14s\n", "threads", "seconds", "speedup", "efficiency", "steals", "primes");
+    double base = 0.0;
+    for (size_t i = 0; i < steps.size(); ++i) {
+        auto start = steady_clock::now();
+        uint64_t count = parallelSieveCount(pool, steps[i], basePrimes, limit);
+        double seconds = duration<double>(steady_clock::now() - start).count();
+        if (i == 0)
+            base = seconds;
+        double speedup = seconds > 0 ? base / seconds : 0.0;
+        printf("%8u %12.3f %10.2f %10.1f%% %10llu %14llu\n", steps[i], seconds, speedup, speedup / steps[i] * 100.0,
+               static_cast<unsigned long long>(pool.steals()), static_cast<unsigned long long>(count));
+    }
+}
+
+// Point checks and batch throughput for 64-bit primality on random odd
+// numbers (mostly composite, most rejected by the first base) and on
+// random primes (all bases run), one thread.
+void primalityBench(size_t count) {
+    mt19937_64 rng(12345);
+    vector<uint64_t> odd(count), primes(count);
+    for (size_t i = 0; i < count; ++i) {
+        odd[i] = rng() | 1;
+        primes[i] = rng() | 1;
+        while (!isPrime64(primes[i]))
+            primes[i] += 2;
+    }
+    vector<uint8_t> result(count);
+    const vector<uint64_t>* inputs[2] = {&odd, &primes};
+    const char* names[2] = {"random odd", "primes"};
+    for (int k = 0; k < 2; ++k) {
+        const vector<uint64_t>& in = *inputs[k];
+        auto start = steady_clock::now();
+        size_t scalarPrimes = 0;
+        for (size_t i = 0; i < count; ++i)
+            scalarPrimes += isPrime64(in[i]);
+        double scalar = duration<double>(steady_clock::now() - start).count();
+        start = steady_clock::now();
+        size_t batchPrimes = isPrimeBatch(&in[0], count, &result[0]);
+        double batch = duration<double>(steady_clock::now() - start).count();
+        printf("%-10s  isPrime64 %7.2f M/s  isPrimeBatch %7.2f M/s  (%zu of %zu prime%s)\n", names[k],
+               count / scalar / 1e6, count / batch / 1e6, batchPrimes, count,
+               scalarPrimes == batchPrimes ? "" : ", MISMATCH");
+    }
+}
+
+// Regression check of the sieves on fixed windows, including the last one
+// below 2^64 where a multiple rounded up past the window wraps around.
+// Each window is counted by SegmentedSieve, by PrimeStream and by
+// Miller-Rabin on every odd number. The base primes reach 2^32 (about
+// 800 MB), and the run takes around half a minute on one core.
+int selfTest() {
+    const uint64_t top = ~0ULL;
+    const uint64_t windows[][2] = {
+        {0, 1000000},
+        {4294967296ULL - 100000, 4294967296ULL + 100000},
+        {1000000000000000000ULL, 1000000000000000000ULL + 100000},
+        {top - 100000, top},
+        {top - 1000000, top - 900000},
+    };
+    const vector<uint32_t> basePrimes = sieveBasePrimes(isqrt64(top));
+    SegmentedSieve sieve(basePrimes);
+    bool ok = true;
+    for (size_t k = 0; k < sizeof(windows) / sizeof(windows[0]); ++k) {
+        uint64_t start = windows[k][0], end = windows[k][1];
+        uint64_t expected = start <= 2 && 2 < end ? 1 : 0;
+        for (uint64_t n = start | 1; n < end; n += 2)
+            expected += isPrime64(n);
+        uint64_t sieved = sieve.count(start, end);
+        uint64_t streamed = 0;
+        forEachPrime(start, end, [&](const uint64_t*, size_t count) { streamed += count; });
+        bool match = sieved == expected && streamed == expected;
+        cout << "[" << start << ", " << end << "): Miller-Rabin " << expected << ", sieve " << sieved << ", stream "
+             << streamed << (match ? "  OK" : "  MISMATCH") << endl;
+        ok = ok && match;
+    }
+    return ok ? 0 : 1;
+}
+
+// Leading decimal digits of text as an unsigned 64-bit value, with end
+// set past them on success. strtoull alone would wrap "-5" to 2^64 - 5 and saturate
+// values past 2^64; both are rejected here.
+bool parseUnsigned(const char* text, unsigned long long& value, char*& end) {
+    const char* p = text;
+    while (isspace(static_cast<unsigned char>(*p)))
+        ++p;
+    if (*p == '-')
+        return false;
+    errno = 0;
+    value = strtoull(text, &end, 10);
+    return end != text && errno != ERANGE;
+}
+
+// A count given as digits or as "1e14".
+bool parseCount(const char* text, unsigned long long& value) {
+    char* end;
+    if (!parseUnsigned(text, value, end))
+        return false;
+    if (*end == 'e' || *end == 'E') {
+        char* expEnd;
+        long exponent = strtol(end + 1, &expEnd, 10);
+        if (*expEnd != '\0' || exponent < 0 || exponent > 19)
+            return false;
+        for (long k = 0; k < exponent; ++k) {
+            if (value > ~0ULL / 10)
+                return false;
+            value *= 10;
+        }
+        return true;
+    }
+    return *end == '\0';
+}
+
+// pi(x) by the combinatorial method (prime_count.h). With verify, the
+// result is cross-checked against the sieve: in full when x is at most
+// 1e10, and always on the window (x - w, x] with w = min(x, 1e9), which
+// must hold pi(x) - pi(x - w) primes. The window check is two more pi runs
+// and a sieve of 1e9 numbers, so it stays cheap for any x.
+int primePiMode(WorkStealingPool& pool, unsigned long long x, bool verify) {
+    PrimePi primePi(pool);
+    PrimePiStats stats;
+    auto start = steady_clock::now();
+    uint64_t count = primePi.count(x, &stats);
+    double seconds = duration<double>(steady_clock::now() - start).count();
+    cout << "pi(" << x << ") = " << count << endl;
+    printf("Time taken: %.3f seconds on %u threads", seconds, pool.size());
+    if (stats.y)
+        printf(" (y = %llu, %llu special leaves, sieved to %llu)", static_cast<unsigned long long>(stats.y),
+               static_cast<unsigned long long>(stats.leaves), static_cast<unsigned long long>(stats.sieved));
+    printf("\n");
+    if (!verify)
+        return 0;
+
+    const vector<uint32_t> basePrimes = sieveBasePrimes(isqrt64(x));
+    bool ok = true;
+    if (x <= 10000000000ULL) {
+        uint64_t sieved = parallelSieveCount(pool, 0, basePrimes, x + 1);
+        cout << "Sieve pi(" << x << ") = " << sieved << (sieved == count ? "  OK" : "  MISMATCH") << endl;
+        ok = sieved == count;
+    }
+    unsigned long long window = min<unsigned long long>(x, 1000000000ULL);
+    uint64_t below = primePi.count(x - window);
+    uint64_t sieved = parallelSieveCount(pool, 0, basePrimes, x + 1, x - window + 1);
+    cout << "Primes in (" << x - window << ", " << x << "]: pi difference " << count - below << ", sieve " << sieved
+         << (sieved == count - below ? "  OK" : "  MISMATCH") << endl;
+    ok = ok && sieved == count - below;
+    return ok ? 0 : 1;
+}
 
-    for (int i = 0; i < num_threads; ++i) {
-        unsigned long long start = (limit / num_threads) * i;
-        unsigned long long end = (limit / num_threads) * (i + 1);
-        futures.push_back(async(launch::async, [&prime_count, start, end] {
-            int local_count = segmentedSieveCount(start, end);
-            lock_guard<mutex> lock(prime_count_mutex);  // Lock the mutex
-            prime_count += local_count;  // Update the shared prime_count
-            return local_count;
-        }));
+// The primes of [start, end): printed one per line with print, else their
+// count, sum, twin primes and gap statistics from primeRangeStats.
+int primeRangeMode(WorkStealingPool& pool, unsigned long long start, unsigned long long end, bool print) {
+    auto begin = steady_clock::now();
+    if (print) {
+        // Formatted into a buffer and written in large blocks; a stream
+        // insertion per prime would cost more than finding it.
+        vector<char> out;
+        out.reserve(1 << 20);
+        forEachPrime(start, end, [&](const uint64_t* primes, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                char digits[24];
+                int n = snprintf(digits, sizeof(digits), "%llu\n", static_cast<unsigned long long>(primes[i]));
+                out.insert(out.end(), digits, digits + n);
+            }
+            if (out.size() >= (1 << 20) - 4096) {
+                fwrite(&out[0], 1, out.size(), stdout);
+                out.clear();
+            }
+        });
+        if (!out.empty())
+            fwrite(&out[0], 1, out.size(), stdout);
+        return 0;
     }
 
-    for (auto& future : futures) {
-        future.get();  // Wait for all threads to finish
+    PrimeRangeStats stats = primeRangeStats(pool, start, end);
+    double seconds = duration<double>(steady_clock::now() - begin).count();
+    cout << "Primes in [" << start << ", " << end << "): " << stats.count << endl;
+    if (stats.count > 0) {
+        cout << "First " << stats.first << ", last " << stats.last << ", sum " << stats.sum() << endl;
+        cout << "Twin prime pairs: " << stats.twins << endl;
+        printf("Gaps: mean %.3f, max %llu after %llu\n", stats.meanGap(), static_cast<unsigned long long>(stats.maxGap),
+               static_cast<unsigned long long>(stats.maxGapAfter));
+        size_t common = 0;
+        for (size_t g = 1; g < stats.gaps.size(); ++g)
+            common = stats.gaps[g] > stats.gaps[common] ? g : common;
+        printf("Most common gap: %zu (%llu times)\n", common ? 2 * common : 1,
+               static_cast<unsigned long long>(stats.gaps[common]));
     }
+    double rate = seconds > 0 ? stats.count / seconds / 1e6 : 0.0;
+    printf("Time taken: %.3f seconds on %u threads (%.1f million primes/s, %.1f per thread)\n", seconds, pool.size(),
+           rate, rate / pool.size());
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    // Counts primes below limit; defaults to 1 billion.
+    //   PRIME_CHECK [limit] [--threads N] [--scaling]
+    //   PRIME_CHECK --check n [n ...]
+    //   PRIME_CHECK --check-bench [count]
+    //   PRIME_CHECK --pi x [--verify] [--threads N]
+    //   PRIME_CHECK --range start end [--print] [--threads N]
+    //   PRIME_CHECK --self-test
+    unsigned long long limit = 1000000000;
+    unsigned long long piX = 0;
+    unsigned long long rangeStart = 0, rangeEnd = 0;
+    bool range = false;
+    bool print = false;
+    unsigned num_threads = max(1u, thread::hardware_concurrency());
+    bool scaling = false;
+    bool verify = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--check") == 0) {
+            for (++i; i < argc; ++i) {
+                char* end;
+                unsigned long long n;
+                if (!parseUnsigned(argv[i], n, end) || *end != '\0') {
+                    cerr << "Error: Invalid number " << argv[i] << endl;
+                    return 1;
+                }
+                cout << n << (isPrime(n) ? " is prime" : " is not prime") << endl;
+            }
+            return 0;
+        } else if (strcmp(argv[i], "--self-test") == 0) {
+            return selfTest();
+        } else if (strcmp(argv[i], "--check-bench") == 0) {
+            size_t count = i + 1 < argc ? static_cast<size_t>(strtoull(argv[i + 1], nullptr, 10)) : 0;
+            primalityBench(count > 0 ? count : 1000000);
+            return 0;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            // The pool allocates a queue per thread up front; cap the count
+            // so a typo is an error here, not std::bad_alloc there.
+            const unsigned long long kMaxThreads = 4096;
+            char* end;
+            unsigned long long n;
+            if (!parseUnsigned(argv[++i], n, end) || *end != '\0' || n == 0 || n > kMaxThreads) {
+                cerr << "Error: Invalid thread count " << argv[i] << " (1 to " << kMaxThreads << ")" << endl;
+                return 1;
+            }
+            num_threads = static_cast<unsigned>(n);
+        } else if (strcmp(argv[i], "--scaling") == 0) {
+            scaling = true;
+        } else if (strcmp(argv[i], "--pi") == 0 && i + 1 < argc) {
+            if (!parseCount(argv[++i], piX) || piX == 0) {
+                cerr << "Error: Invalid x " << argv[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            verify = true;
+        } else if (strcmp(argv[i], "--range") == 0 && i + 2 < argc) {
+            if (!parseCount(argv[i + 1], rangeStart) || !parseCount(argv[i + 2], rangeEnd) || rangeStart > rangeEnd) {
+                cerr << "Error: Invalid range " << argv[i + 1] << " " << argv[i + 2] << endl;
+                return 1;
+            }
+            range = true;
+            i += 2;
+        } else if (strcmp(argv[i], "--print") == 0) {
+            print = true;
+        } else {
+            if (!parseCount(argv[i], limit) || limit == 0) {
+                cerr << "Error: Invalid limit " << argv[i] << endl;
+                return 1;
+            }
+        }
+    }
+
+    if (piX) {
+        WorkStealingPool pool(num_threads);
+        return primePiMode(pool, piX, verify);
+    }
+    if (range) {
+        WorkStealingPool pool(num_threads);
+        return primeRangeMode(pool, rangeStart, rangeEnd, print);
+    }
+
+    auto start_time = high_resolution_clock::now();
+
+    // Base primes are sieved once and shared by every worker.
+    const vector<uint32_t> basePrimes = sieveBasePrimes(isqrt64(limit));
+    WorkStealingPool pool(num_threads);
+
+    if (scaling) {
+        scalingReport(pool, basePrimes, limit);
+        return 0;
+    }
+
+    uint64_t prime_count = parallelSieveCount(pool, 0, basePrimes, limit);
 
     auto end_time = high_resolution_clock::now();
     auto duration = duration_cast<seconds>(end_time - start_time).count();
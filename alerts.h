@@ -0,0 +1,232 @@
+#ifndef ALERTS_H
+#define ALERTS_H
+
+// Incremental alerting on the sample stream.
+//
+// Every metric carries an AlertDetector that sees each sample right after
+// the usage statistics are updated. It keeps an exponentially weighted
+// mean and variance (O(1) per sample, no history) and raises two kinds of
+// alert, each with hysteresis so a value hovering at the edge does not
+// flap:
+//
+//   threshold  fires at value >= threshold, clears below threshold - hysteresis
+//   anomaly    fires at |z| >= fireZ, clears below clearZ, where z is the
+//              distance of the sample from the EWMA mean in EWMA standard
+//              deviations, measured before the sample is folded in
+//
+// Transitions are kept in a small ring per detector, numbered by a running
+// sequence. Sinks read them by sequence number, so draining needs only a
+// const view of the core and a sink that falls behind by more than the
+// ring size loses (and counts) the oldest events instead of blocking the
+// sampler. AlertSink appends them to their own log file.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+enum AlertKind { ALERT_THRESHOLD, ALERT_ANOMALY };
+
+struct AlertEvent {
+    int64_t timestampNs; // wall clock
+    AlertKind kind;
+    bool firing; // false when the alert clears
+    double value;
+    double mean;
+    double stddev;
+    double z;
+};
+
+struct AlertConfig {
+    double threshold;  // percent; <= 0 disables the threshold alert
+    double hysteresis; // percentage points below threshold to clear
+    double alpha;      // EWMA weight of the newest sample
+    double fireZ;      // <= 0 disables the anomaly alert
+    double clearZ;     // below fireZ; the gap is the anomaly hysteresis
+    double minStddev;  // floor, so a flat metric does not alert on noise
+    unsigned warmup;   // samples before z-scores are trusted
+
+    AlertConfig()
+        : threshold(90.0), hysteresis(5.0), alpha(0.05), fireZ(4.0), clearZ(2.0), minStddev(1.0), warmup(30) {}
+};
+
+class AlertDetector {
+public:
+    static const unsigned kCapacity = 16;
+
+    AlertDetector() : samples_(0), mean_(0.0), variance_(0.0), z_(0.0), thresholdFiring_(false),
+                      anomalyFiring_(false), emitted_(0) {}
+
+    // A clearZ above fireZ would clear an alert on the sample after it
+    // fires; it is capped at fireZ.
+    void configure(const AlertConfig& config) {
+        config_ = config;
+        config_.clearZ = std::min(config_.clearZ, config_.fireZ);
+    }
+    const AlertConfig& config() const { return config_; }
+
+    void update(double value) {
+        double diff = value - mean_;
+        double sd = stddev();
+        z_ = samples_ >= config_.warmup ? diff / sd : 0.0;
+
+        if (config_.threshold > 0) {
+            if (!thresholdFiring_ && value >= config_.threshold)
+                transition(ALERT_THRESHOLD, thresholdFiring_ = true, value, sd);
+            else if (thresholdFiring_ && value < config_.threshold - config_.hysteresis)
+                transition(ALERT_THRESHOLD, thresholdFiring_ = false, value, sd);
+        }
+        if (config_.fireZ > 0 && samples_ >= config_.warmup) {
+            double absZ = std::fabs(z_);
+            if (!anomalyFiring_ && absZ >= config_.fireZ)
+                transition(ALERT_ANOMALY, anomalyFiring_ = true, value, sd);
+            else if (anomalyFiring_ && absZ < config_.clearZ)
+                transition(ALERT_ANOMALY, anomalyFiring_ = false, value, sd);
+        }
+
+        // Incremental EWMA mean and variance (West, 1979); the first sample
+        // seeds the mean.
+        if (samples_ == 0) {
+            mean_ = value;
+        } else {
+            double increment = config_.alpha * diff;
+            mean_ += increment;
+            variance_ = (1.0 - config_.alpha) * (variance_ + diff * increment);
+        }
+        ++samples_;
+    }
+
+    double mean() const { return mean_; }
+    double stddev() const { return std::max(std::sqrt(variance_), config_.minStddev); }
+    double z() const { return z_; }
+    bool thresholdFiring() const { return thresholdFiring_; }
+    bool anomalyFiring() const { return anomalyFiring_; }
+
+    // Events are numbered from 0; the last kCapacity are kept.
+    uint64_t emitted() const { return emitted_; }
+    const AlertEvent& event(uint64_t sequence) const { return events_[sequence % kCapacity]; }
+
+private:
+    void transition(AlertKind kind, bool firing, double value, double sd) {
+        AlertEvent& e = events_[emitted_ % kCapacity];
+        e.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::system_clock::now().time_since_epoch())
+                            .count();
+        e.kind = kind;
+        e.firing = firing;
+        e.value = value;
+        e.mean = mean_;
+        e.stddev = sd;
+        e.z = z_;
+        ++emitted_;
+    }
+
+    AlertConfig config_;
+    unsigned samples_;
+    double mean_;
+    double variance_;
+    double z_;
+    bool thresholdFiring_;
+    bool anomalyFiring_;
+    uint64_t emitted_;
+    AlertEvent events_[kCapacity];
+};
+
+// Appends alert transitions to a log file, one line each, e.g.
+//   2026-10-17T09:14:02Z CPU threshold FIRING value 93.1% threshold 90%
+//   2026-10-17T09:14:40Z CPU anomaly RESOLVED value 22.4% mean 21.9% stddev 3.2% z 0.15
+//
+// Without openFile the sink only formats: collect() returns the lines and
+// the caller writes them out, e.g. from a background thread.
+class AlertSink {
+public:
+    explicit AlertSink(const std::string& path, bool openFile = true) : path_(path), written_(0), lost_(0) {
+        if (!openFile)
+            return;
+        out_.open(path.c_str(), std::ios::app);
+        if (!out_.is_open())
+            std::cerr << "Error: Could not open alert log " << path << std::endl;
+    }
+
+    AlertSink(const AlertSink&) = delete;
+    AlertSink& operator=(const AlertSink&) = delete;
+
+    // Appends to out one line per event metric `index` has raised since
+    // the last call. No I/O.
+    void collect(size_t index, const char* label, const AlertDetector& detector, std::string& out) {
+        if (index >= seen_.size())
+            seen_.resize(index + 1, 0);
+        uint64_t& seen = seen_[index];
+        uint64_t emitted = detector.emitted();
+        if (emitted == seen)
+            return;
+        if (emitted - seen > AlertDetector::kCapacity) {
+            lost_ += emitted - seen - AlertDetector::kCapacity;
+            seen = emitted - AlertDetector::kCapacity;
+        }
+        for (; seen < emitted; ++seen)
+            formatEvent(label, detector.config(), detector.event(seen), out);
+    }
+
+    // The same for every metric of a core, in visit order.
+    template <typename Core>
+    void collect(const Core& core, std::string& out) {
+        size_t index = 0;
+        core.forEach([&](const char* label, const char*, const typename Core::State& m) {
+            collect(index++, label, m.alerts, out);
+        });
+    }
+
+    // Sink interface for runMonitor(): writes and flushes the new events.
+    template <typename Core>
+    void write(const Core& core) {
+        std::string lines;
+        collect(core, lines);
+        if (!lines.empty() && out_.is_open()) {
+            out_ << lines;
+            out_.flush();
+        }
+    }
+
+    const std::string& path() const { return path_; }
+    unsigned long long written() const { return written_; }
+    unsigned long long lost() const { return lost_; }
+
+private:
+    void formatEvent(const char* label, const AlertConfig& config, const AlertEvent& e, std::string& out) {
+        ++written_;
+        time_t seconds = static_cast<time_t>(e.timestampNs / 1000000000LL);
+        struct tm utc;
+#ifdef _WIN32
+        gmtime_s(&utc, &seconds);
+#else
+        gmtime_r(&seconds, &utc);
+#endif
+        char stamp[32];
+        strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+        line_.str("");
+        line_ << stamp << " " << label << (e.kind == ALERT_THRESHOLD ? " threshold " : " anomaly ")
+              << (e.firing ? "FIRING" : "RESOLVED") << " value " << e.value << "%";
+        if (e.kind == ALERT_THRESHOLD)
+            line_ << " threshold " << config.threshold << "%";
+        else
+            line_ << " mean " << e.mean << "% stddev " << e.stddev << "% z " << e.z;
+        line_ << "\n";
+        out += line_.str();
+    }
+
+    std::string path_;
+    std::ofstream out_;
+    std::ostringstream line_;
+    std::vector<uint64_t> seen_;
+    unsigned long long written_;
+    unsigned long long lost_;
+};
+
+#endif
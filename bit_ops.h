@@ -0,0 +1,90 @@
+#ifndef BIT_OPS_H
+#define BIT_OPS_H
+
+// Bit counting on 64-bit words, with MSVC intrinsics where GCC and Clang
+// have builtins. leadingZeros64 and trailingZeros64 need x != 0.
+//
+// loadBigEndian64 and storeBigEndian64 move words to and from byte streams
+// in big-endian order whatever the host's byte order: a byte swap on
+// little-endian hosts, a plain copy on big-endian ones, and byte-by-byte
+// shifts where the compiler does not say which it is.
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+inline int popcount64(uint64_t x) {
+#ifdef _MSC_VER
+    return static_cast<int>(__popcnt64(x));
+#else
+    return __builtin_popcountll(x);
+#endif
+}
+
+inline int leadingZeros64(uint64_t x) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return 63 - static_cast<int>(index);
+#else
+    return __builtin_clzll(x);
+#endif
+}
+
+inline int trailingZeros64(uint64_t x) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+inline uint64_t byteSwap64(uint64_t x) {
+#ifdef _MSC_VER
+    return _byteswap_uint64(x);
+#else
+    return __builtin_bswap64(x);
+#endif
+}
+
+// MSVC only targets little-endian machines.
+#if defined(_MSC_VER) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define BIT_OPS_LITTLE_ENDIAN
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define BIT_OPS_BIG_ENDIAN
+#endif
+
+inline uint64_t loadBigEndian64(const uint8_t* p) {
+#if defined(BIT_OPS_LITTLE_ENDIAN) || defined(BIT_OPS_BIG_ENDIAN)
+    uint64_t x;
+    std::memcpy(&x, p, sizeof(x));
+#ifdef BIT_OPS_LITTLE_ENDIAN
+    x = byteSwap64(x);
+#endif
+    return x;
+#else
+    uint64_t x = 0;
+    for (int i = 0; i < 8; ++i)
+        x = (x << 8) | p[i];
+    return x;
+#endif
+}
+
+inline void storeBigEndian64(uint8_t* p, uint64_t x) {
+#if defined(BIT_OPS_LITTLE_ENDIAN) || defined(BIT_OPS_BIG_ENDIAN)
+#ifdef BIT_OPS_LITTLE_ENDIAN
+    x = byteSwap64(x);
+#endif
+    std::memcpy(p, &x, sizeof(x));
+#else
+    for (int i = 0; i < 8; ++i)
+        p[i] = static_cast<uint8_t>(x >> (56 - 8 * i));
+#endif
+}
+
+#endif
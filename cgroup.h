@@ -0,0 +1,345 @@
+#ifndef CGROUP_H
+#define CGROUP_H
+
+// cgroup v2 collectors: what the container (or any named cgroup) uses,
+// measured against its own limits rather than the host's.
+//
+// The cgroup is the one this process runs in (the "0::" line of
+// /proc/self/cgroup) unless a path is given, resolved under the cgroup2
+// mount found in /proc/self/mountinfo, so hybrid hosts that mount it at
+// /sys/fs/cgroup/unified work too. Each interface file is opened once and
+// re-read with pread into a fixed buffer, as the /proc collectors do.
+// Limits (cpu.max, memory.max) are re-read every sample because they can
+// be changed at run time. A file the kernel does not expose for this
+// cgroup (the root cgroup has no limits; controllers may not be enabled)
+// just leaves its part of the sample unset.
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "io_rates.h"
+#include "proc_backend.h"
+
+// One PSI line ("some" or "full"): share of wall time stalled, in percent.
+struct PressureAverages {
+    double avg10;
+    double avg60;
+    double avg300;
+};
+
+struct CgroupPressure {
+    bool present;
+    PressureAverages some; // at least one task stalled
+    PressureAverages full; // all non-idle tasks stalled
+};
+
+struct CgroupIoRate {
+    char device[32]; // "major:minor"
+    double readBytes;  // per second
+    double writeBytes; // per second
+    double readOps;    // per second
+    double writeOps;   // per second
+};
+
+struct CgroupUsage {
+    bool haveCpu;
+    double cpuCores;          // CPUs' worth of time used over the interval
+    double cpuLimitCores;     // cpu.max quota / period, or online CPUs if unlimited
+    bool cpuLimited;          // cpu.max sets a quota
+    double cpuPercentOfLimit; // cpuCores / cpuLimitCores
+    double throttledPercent;  // share of enforcement periods that hit the quota
+    double throttledMsPerSec; // time spent throttled per wall second
+    unsigned long long throttledPeriods; // since the cgroup was created
+
+    bool haveMemory;
+    double memoryBytes;      // memory.current
+    double memoryLimitBytes; // memory.max, or host MemTotal if unlimited
+    bool memoryLimited;
+    double memoryPercentOfLimit;
+
+    bool haveIo;
+    std::vector<CgroupIoRate> io;
+
+    CgroupPressure cpuPressure;
+    CgroupPressure memoryPressure;
+    CgroupPressure ioPressure;
+};
+
+// Mount point of the cgroup2 hierarchy, or "" if there is none.
+inline std::string cgroup2Mount() {
+    std::unique_ptr<ProcFile<1 << 16>> mountinfo(new ProcFile<1 << 16>("/proc/self/mountinfo"));
+    if (!mountinfo->read())
+        return "";
+    // "id parent major:minor root mountpoint options ... - fstype source options"
+    for (const char* p = mountinfo->buf; *p; p = nextLine(p)) {
+        const char* end = std::strchr(p, '\n');
+        std::string line(p, end ? static_cast<size_t>(end - p) : std::strlen(p));
+        size_t dash = line.find(" - ");
+        if (dash == std::string::npos || line.compare(dash + 3, 8, "cgroup2 ") != 0)
+            continue;
+        size_t field = 0, start = 0;
+        for (int i = 0; i < 4 && field != std::string::npos; ++i) {
+            field = line.find(' ', start);
+            start = field + 1;
+        }
+        if (field == std::string::npos)
+            continue;
+        size_t stop = line.find(' ', start);
+        return line.substr(start, stop == std::string::npos ? std::string::npos : stop - start);
+    }
+    return "";
+}
+
+// Directory of the named cgroup (a path relative to the cgroup2 root, e.g.
+// "/system.slice/nginx.service"), or of this process's own cgroup when
+// name is empty. Returns "" if there is no cgroup v2 hierarchy.
+inline std::string findCgroup(const std::string& name) {
+    std::string mount = cgroup2Mount();
+    if (mount.empty())
+        return "";
+    std::string path = name;
+    if (path.empty()) {
+        ProcFile<4096> self("/proc/self/cgroup");
+        if (!self.read())
+            return "";
+        for (const char* p = self.buf; *p; p = nextLine(p)) {
+            if (std::strncmp(p, "0::", 3) == 0) {
+                const char* end = std::strchr(p, '\n');
+                path.assign(p + 3, end ? static_cast<size_t>(end - p - 3) : std::strlen(p + 3));
+                break;
+            }
+        }
+        if (path.empty())
+            return "";
+    }
+    if (path[0] != '/')
+        path = "/" + path;
+    std::string dir = mount + (path == "/" ? "" : path);
+    if (!procPathExists((dir + "/cgroup.procs").c_str()))
+        return "";
+    return dir;
+}
+
+// Parses "some avg10=0.12 avg60=0.05 avg300=0.01 total=12345" lines.
+inline bool parsePressure(const char* buf, CgroupPressure& out) {
+    std::memset(&out, 0, sizeof(out));
+    for (const char* p = buf; *p; p = nextLine(p)) {
+        PressureAverages* avg = std::strncmp(p, "some ", 5) == 0 ? &out.some
+                              : (std::strncmp(p, "full ", 5) == 0 ? &out.full : nullptr);
+        if (!avg)
+            continue;
+        const char* q = p + 5;
+        for (int i = 0; i < 3; ++i) {
+            q = std::strchr(q, '=');
+            if (!q)
+                return false;
+            char* end;
+            double v = std::strtod(q + 1, &end);
+            (i == 0 ? avg->avg10 : (i == 1 ? avg->avg60 : avg->avg300)) = v;
+            q = end;
+        }
+        out.present = true;
+    }
+    return out.present;
+}
+
+class CgroupSampler {
+public:
+    explicit CgroupSampler(const std::string& dir)
+        : dir_(dir), cpuStat_(file("cpu.stat")), cpuMax_(file("cpu.max")), memoryCurrent_(file("memory.current")),
+          memoryMax_(file("memory.max")), ioStat_(new ProcFile<1 << 14>((dir + "/io.stat").c_str())),
+          cpuPressure_(file("cpu.pressure")), memoryPressure_(file("memory.pressure")),
+          ioPressure_(file("io.pressure")), hostMemoryBytes_(0.0), onlineCpus_(1.0), prevNs_(0), prevUsageUsec_(0),
+          prevPeriods_(0), prevThrottled_(0), prevThrottledUsec_(0) {
+        RamSampler ram;
+        if (ram.meminfo.read()) {
+            for (const char* p = ram.meminfo.buf; *p; p = nextLine(p)) {
+                if (std::strncmp(p, "MemTotal:", 9) == 0) {
+                    const char* q = p + 9;
+                    unsigned long long kb;
+                    if (scanField(q, kb))
+                        hostMemoryBytes_ = kb * 1024.0;
+                    break;
+                }
+            }
+        }
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (cpus > 0)
+            onlineCpus_ = static_cast<double>(cpus);
+    }
+
+    CgroupSampler(const CgroupSampler&) = delete;
+    CgroupSampler& operator=(const CgroupSampler&) = delete;
+
+    const std::string& path() const { return dir_; }
+
+    // Fills whatever this cgroup exposes. Rates need two samples, so the
+    // first call only primes the CPU and I/O counters. Returns false if
+    // nothing at all could be read.
+    bool sample(CgroupUsage& out) {
+        long long now = monotonicNs();
+        double seconds = prevNs_ ? (now - prevNs_) / 1e9 : 0.0;
+        prevNs_ = now;
+
+        out.haveCpu = sampleCpu(seconds, out);
+        out.haveMemory = sampleMemory(out);
+        out.haveIo = sampleIo(seconds, out.io);
+        bool any = out.haveCpu || out.haveMemory || out.haveIo;
+        any = pressure(*cpuPressure_, out.cpuPressure) || any;
+        any = pressure(*memoryPressure_, out.memoryPressure) || any;
+        any = pressure(*ioPressure_, out.ioPressure) || any;
+        return any;
+    }
+
+private:
+    typedef ProcFile<512> SmallFile;
+
+    SmallFile* file(const char* name) const { return new SmallFile((dir_ + "/" + name).c_str()); }
+
+    bool sampleCpu(double seconds, CgroupUsage& out) {
+        if (!cpuStat_->read())
+            return false;
+        unsigned long long usage = 0, periods = 0, throttled = 0, throttledUsec = 0;
+        for (const char* p = cpuStat_->buf; *p; p = nextLine(p)) {
+            const char* q = std::strchr(p, ' ');
+            if (!q)
+                break;
+            size_t len = static_cast<size_t>(q - p);
+            unsigned long long* field = len == 10 && std::strncmp(p, "usage_usec", 10) == 0       ? &usage
+                                      : len == 10 && std::strncmp(p, "nr_periods", 10) == 0       ? &periods
+                                      : len == 12 && std::strncmp(p, "nr_throttled", 12) == 0     ? &throttled
+                                      : len == 14 && std::strncmp(p, "throttled_usec", 14) == 0   ? &throttledUsec
+                                                                                                  : nullptr;
+            if (field)
+                scanField(q, *field);
+        }
+
+        // "max 100000" or "<quota> <period>", both in microseconds.
+        out.cpuLimited = false;
+        out.cpuLimitCores = onlineCpus_;
+        if (cpuMax_->read()) {
+            const char* q = cpuMax_->buf;
+            unsigned long long quota, period;
+            if (scanField(q, quota) && scanField(q, period) && period > 0) {
+                out.cpuLimited = true;
+                out.cpuLimitCores = static_cast<double>(quota) / period;
+            }
+        }
+
+        bool primed = seconds > 0 && usage >= prevUsageUsec_;
+        out.cpuCores = primed ? (usage - prevUsageUsec_) / (seconds * 1e6) : 0.0;
+        out.cpuPercentOfLimit = out.cpuLimitCores > 0 ? out.cpuCores / out.cpuLimitCores * 100.0 : 0.0;
+        out.throttledPercent = primed && periods > prevPeriods_
+                                   ? static_cast<double>(throttled - prevThrottled_) / (periods - prevPeriods_) * 100.0
+                                   : 0.0;
+        out.throttledMsPerSec = primed ? (throttledUsec - prevThrottledUsec_) / 1000.0 / seconds : 0.0;
+        out.throttledPeriods = throttled;
+        prevUsageUsec_ = usage;
+        prevPeriods_ = periods;
+        prevThrottled_ = throttled;
+        prevThrottledUsec_ = throttledUsec;
+        return true;
+    }
+
+    bool sampleMemory(CgroupUsage& out) {
+        unsigned long long current;
+        const char* p = memoryCurrent_->buf;
+        if (!memoryCurrent_->read() || !scanField(p, current))
+            return false;
+        out.memoryBytes = static_cast<double>(current);
+        out.memoryLimited = false;
+        out.memoryLimitBytes = hostMemoryBytes_;
+        unsigned long long limit;
+        p = memoryMax_->buf;
+        if (memoryMax_->read() && scanField(p, limit)) { // "max" fails the scan
+            out.memoryLimited = true;
+            out.memoryLimitBytes = static_cast<double>(limit);
+        }
+        out.memoryPercentOfLimit = out.memoryLimitBytes > 0 ? out.memoryBytes / out.memoryLimitBytes * 100.0 : 0.0;
+        return true;
+    }
+
+    // "8:0 rbytes=1 wbytes=2 rios=3 wios=4 dbytes=0 dios=0" per device.
+    bool sampleIo(double seconds, std::vector<CgroupIoRate>& out) {
+        out.clear();
+        if (!ioStat_->read())
+            return false;
+        ioTable_.beginSample();
+        for (const char* p = ioStat_->buf; *p; p = nextLine(p)) {
+            const char* name = p;
+            while (*p && *p != ' ' && *p != '\n')
+                ++p;
+            CounterTable<kIoFields>::Row& r = ioTable_.row(name, static_cast<size_t>(p - name));
+            int found = 0;
+            while (*p == ' ') {
+                ++p;
+                const char* key = p;
+                const char* eq = std::strchr(p, '=');
+                if (!eq)
+                    break;
+                p = eq + 1;
+                unsigned long long v = 0;
+                scanField(p, v);
+                size_t len = static_cast<size_t>(eq - key);
+                int field = len == 6 && std::strncmp(key, "rbytes", 6) == 0   ? RBYTES
+                          : len == 6 && std::strncmp(key, "wbytes", 6) == 0   ? WBYTES
+                          : len == 4 && std::strncmp(key, "rios", 4) == 0     ? RIOS
+                          : len == 4 && std::strncmp(key, "wios", 4) == 0     ? WIOS
+                                                                              : -1;
+                if (field >= 0) {
+                    r.cur[field] = v;
+                    ++found;
+                }
+            }
+            r.present = found == kIoFields;
+        }
+        for (size_t i = 0; i < ioTable_.rows.size(); ++i) {
+            const CounterTable<kIoFields>::Row& r = ioTable_.rows[i];
+            if (!r.present || !r.primed || seconds <= 0)
+                continue;
+            CgroupIoRate rate;
+            std::memcpy(rate.device, r.name, sizeof(rate.device));
+            rate.readBytes = (r.cur[RBYTES] - r.prev[RBYTES]) / seconds;
+            rate.writeBytes = (r.cur[WBYTES] - r.prev[WBYTES]) / seconds;
+            rate.readOps = (r.cur[RIOS] - r.prev[RIOS]) / seconds;
+            rate.writeOps = (r.cur[WIOS] - r.prev[WIOS]) / seconds;
+            out.push_back(rate);
+        }
+        ioTable_.endSample();
+        return true;
+    }
+
+    static bool pressure(SmallFile& f, CgroupPressure& out) {
+        if (!f.read()) {
+            std::memset(&out, 0, sizeof(out));
+            return false;
+        }
+        return parsePressure(f.buf, out);
+    }
+
+    enum IoField { RBYTES, WBYTES, RIOS, WIOS, kIoFields };
+
+    std::string dir_;
+    std::unique_ptr<SmallFile> cpuStat_;
+    std::unique_ptr<SmallFile> cpuMax_;
+    std::unique_ptr<SmallFile> memoryCurrent_;
+    std::unique_ptr<SmallFile> memoryMax_;
+    std::unique_ptr<ProcFile<1 << 14>> ioStat_;
+    std::unique_ptr<SmallFile> cpuPressure_;
+    std::unique_ptr<SmallFile> memoryPressure_;
+    std::unique_ptr<SmallFile> ioPressure_;
+    CounterTable<kIoFields> ioTable_;
+    double hostMemoryBytes_;
+    double onlineCpus_;
+    long long prevNs_;
+    unsigned long long prevUsageUsec_;
+    unsigned long long prevPeriods_;
+    unsigned long long prevThrottled_;
+    unsigned long long prevThrottledUsec_;
+};
+
+#endif
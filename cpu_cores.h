@@ -0,0 +1,174 @@
+#ifndef CPU_CORES_H
+#define CPU_CORES_H
+
+// Per-core, per-mode CPU breakdown from the "cpuN" lines of /proc/stat.
+// Counters and results are kept as structure-of-arrays (one contiguous array
+// per field) so the delta pass is a straight loop the compiler can vectorize,
+// and every core is returned from a single read of /proc/stat. Counters are
+// stored as doubles, which hold jiffy counts exactly up to 2^53, so the delta
+// loop needs no integer-to-float conversion.
+
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+
+#include "proc_backend.h"
+
+enum CpuField {
+    CPU_USER,
+    CPU_NICE,
+    CPU_SYSTEM,
+    CPU_IDLE,
+    CPU_IOWAIT,
+    CPU_IRQ,
+    CPU_SOFTIRQ,
+    CPU_STEAL,
+    CPU_FIELDS
+};
+
+// Percentages per core, one array per mode. user includes nice, irq includes
+// softirq.
+struct CoreUsageTable {
+    int cores;
+    std::vector<double> user;
+    std::vector<double> system;
+    std::vector<double> iowait;
+    std::vector<double> steal;
+    std::vector<double> irq;
+    std::vector<double> busy;
+
+    CoreUsageTable() : cores(0) {}
+
+    void resize(int n) {
+        cores = n;
+        user.assign(n, 0.0);
+        system.assign(n, 0.0);
+        iowait.assign(n, 0.0);
+        steal.assign(n, 0.0);
+        irq.assign(n, 0.0);
+        busy.assign(n, 0.0);
+    }
+};
+
+class CoreSampler {
+public:
+    explicit CoreSampler(int maxCores = 0)
+        : cores_(maxCores > 0 ? maxCores : static_cast<int>(sysconf(_SC_NPROCESSORS_CONF))),
+          stat_(new ProcFile<1 << 17>("/proc/stat")) {
+        if (cores_ < 1)
+            cores_ = 1;
+        for (int f = 0; f < CPU_FIELDS; ++f) {
+            prev_[f].assign(cores_, 0.0);
+            cur_[f].assign(cores_, 0.0);
+        }
+        seen_.assign(cores_, 0);
+        scale_.assign(cores_, 0.0);
+    }
+
+    int cores() const { return cores_; }
+
+    // Fills all cores of out (resizing it on first use). Cores that are
+    // offline keep their counters and report zero for the interval.
+    bool sample(CoreUsageTable& out) {
+        if (out.cores != cores_)
+            out.resize(cores_);
+        if (!stat_->read() || !parse())
+            return false;
+
+        for (int i = 0; i < cores_; ++i) {
+            if (!seen_[i]) {
+                for (int f = 0; f < CPU_FIELDS; ++f)
+                    cur_[f][i] = prev_[f][i];
+            }
+        }
+
+        // Per-core interval total, then turned into a percentage scale. An
+        // empty interval has all deltas zero, so dividing by 1 instead still
+        // yields zeros; the equality test (unlike a ternary on total > 0) is
+        // if-converted and keeps the loop vectorizable.
+        double* scale = scale_.data();
+        for (int i = 0; i < cores_; ++i)
+            scale[i] = 0.0;
+        for (int f = 0; f < CPU_FIELDS; ++f) {
+            const double* c = cur_[f].data();
+            const double* p = prev_[f].data();
+            for (int i = 0; i < cores_; ++i)
+                scale[i] += c[i] - p[i];
+        }
+        for (int i = 0; i < cores_; ++i)
+            scale[i] = 100.0 / (scale[i] + (scale[i] == 0.0));
+
+        percent(out.user, CPU_USER, CPU_NICE);
+        percent(out.system, CPU_SYSTEM, CPU_FIELDS);
+        percent(out.iowait, CPU_IOWAIT, CPU_FIELDS);
+        percent(out.steal, CPU_STEAL, CPU_FIELDS);
+        percent(out.irq, CPU_IRQ, CPU_SOFTIRQ);
+
+        const double* user = out.user.data();
+        const double* system = out.system.data();
+        const double* steal = out.steal.data();
+        const double* irq = out.irq.data();
+        double* busy = out.busy.data();
+        for (int i = 0; i < cores_; ++i)
+            busy[i] = user[i] + system[i] + steal[i] + irq[i];
+
+        for (int f = 0; f < CPU_FIELDS; ++f)
+            std::swap(prev_[f], cur_[f]);
+        return true;
+    }
+
+private:
+    // dst = (delta(a) + delta(b)) * scale; pass CPU_FIELDS as b for one field.
+    void percent(std::vector<double>& dst, CpuField a, CpuField b) {
+        double* d = dst.data();
+        const double* scale = scale_.data();
+        const double* ca = cur_[a].data();
+        const double* pa = prev_[a].data();
+        if (b == CPU_FIELDS) {
+            for (int i = 0; i < cores_; ++i)
+                d[i] = (ca[i] - pa[i]) * scale[i];
+            return;
+        }
+        const double* cb = cur_[b].data();
+        const double* pb = prev_[b].data();
+        for (int i = 0; i < cores_; ++i)
+            d[i] = ((ca[i] - pa[i]) + (cb[i] - pb[i])) * scale[i];
+    }
+
+    bool parse() {
+        std::memset(seen_.data(), 0, seen_.size());
+        const char* p = nextLine(stat_->buf); // skip the aggregate line
+        int parsed = 0;
+        while (p[0] == 'c' && p[1] == 'p' && p[2] == 'u') {
+            p += 3;
+            unsigned long long cpu;
+            if (!scanField(p, cpu))
+                break;
+            if (cpu < static_cast<unsigned long long>(cores_)) {
+                int n = 0;
+                unsigned long long value;
+                while (n < CPU_FIELDS && scanField(p, value))
+                    cur_[n++][cpu] = static_cast<double>(value);
+                if (n >= CPU_IOWAIT + 1) {
+                    for (; n < CPU_FIELDS; ++n)
+                        cur_[n][cpu] = 0.0;
+                    seen_[cpu] = 1;
+                    ++parsed;
+                }
+            }
+            p = nextLine(p);
+        }
+        return parsed > 0;
+    }
+
+    int cores_;
+    std::unique_ptr<ProcFile<1 << 17>> stat_; // room for ~1300 cores
+    std::vector<double> prev_[CPU_FIELDS];
+    std::vector<double> cur_[CPU_FIELDS];
+    std::vector<unsigned char> seen_;
+    std::vector<double> scale_;
+};
+
+#endif
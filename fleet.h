@@ -0,0 +1,595 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+// Streaming samples from many hosts to one aggregator.
+//
+// An agent (resmonitoring --agent) batches its report-tick SampleRecords
+// and sends them as length-prefixed binary frames over a Unix or TCP
+// stream socket:
+//
+//   FrameHeader (20 bytes) | host name (hostLength bytes) | count x SampleRecord
+//
+// FrameHeader.length counts every byte after the length field itself, so
+// a reader needs no other framing. Native byte order, as in sample_log.h.
+// The agent's socket is non-blocking and its sends are driven from the
+// sampler's own tick: unsent frames wait in a bounded buffer, and if the
+// aggregator is down or slow, whole batches are dropped and counted rather
+// than stalling sampling. It reconnects at most once a second.
+//
+// The aggregator accepts any number of agents on one epoll loop, reassembles
+// frames from each connection's byte stream and feeds each host's samples
+// into per-host MetricStates (the same windows, percentiles and alerts a
+// local monitor keeps). Fleet-wide figures are combined from the per-host
+// windows on demand: sample-weighted averages, minimum and maximum, and
+// percentiles from the merged histograms.
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "monitor_core.h"
+#include "sample_log.h"
+
+struct FrameHeader {
+    uint32_t length; // bytes after this field
+    char magic[4];
+    uint16_t hostLength;
+    uint16_t reserved;
+    uint32_t count;      // SampleRecords after the host name
+    uint32_t intervalMs; // the agent's report interval
+};
+
+static_assert(sizeof(FrameHeader) == 20, "FrameHeader must stay 20 bytes");
+
+const char kFrameMagic[4] = {'R', 'M', 'F', '1'};
+const uint32_t kMaxFrameBytes = 1 << 20;
+
+inline int64_t fleetClockNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// "unix:/path/to.sock" or "host:port" (":port" listens on every address).
+struct SocketAddress {
+    struct sockaddr_storage addr;
+    socklen_t length;
+    int family;
+    std::string text;
+};
+
+inline bool resolveAddress(const std::string& text, bool passive, SocketAddress& out) {
+    std::memset(&out.addr, 0, sizeof(out.addr));
+    out.text = text;
+    if (text.compare(0, 5, "unix:") == 0) {
+        struct sockaddr_un* un = reinterpret_cast<struct sockaddr_un*>(&out.addr);
+        std::string path = text.substr(5);
+        if (path.empty() || path.size() >= sizeof(un->sun_path))
+            return false;
+        un->sun_family = AF_UNIX;
+        std::memcpy(un->sun_path, path.c_str(), path.size() + 1);
+        out.length = sizeof(struct sockaddr_un);
+        out.family = AF_UNIX;
+        return true;
+    }
+    size_t colon = text.rfind(':');
+    if (colon == std::string::npos || colon + 1 == text.size())
+        return false;
+    std::string host = text.substr(0, colon);
+    std::string port = text.substr(colon + 1);
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result) != 0 || !result)
+        return false;
+    std::memcpy(&out.addr, result->ai_addr, result->ai_addrlen);
+    out.length = result->ai_addrlen;
+    out.family = result->ai_family;
+    freeaddrinfo(result);
+    return true;
+}
+
+class AgentStream {
+public:
+    // batch is clamped to [1, maxBatch(host)].
+    AgentStream(const std::string& host, std::chrono::milliseconds interval, size_t batch)
+        : host_(host.substr(0, 255)), intervalMs_(static_cast<uint32_t>(interval.count())),
+          batch_(std::min(std::max<size_t>(batch, 1), maxBatch(host))), fd_(-1), connecting_(false),
+          nextAttemptNs_(0), frontSent_(0), frames_(0), sent_(0), dropped_(0), reconnects_(0) {
+        records_.reserve(batch_);
+    }
+
+    // Largest batch whose frame takes at most a quarter of the send buffer,
+    // so several frames can wait out a reconnect. That is also well under
+    // the aggregator's kMaxFrameBytes.
+    static size_t maxBatch(const std::string& host) {
+        size_t hostBytes = std::min<size_t>(host.size(), 255);
+        return (kMaxPendingBytes / 4 - sizeof(FrameHeader) - hostBytes) / sizeof(SampleRecord);
+    }
+
+    ~AgentStream() {
+        if (fd_ >= 0)
+            close(fd_);
+    }
+
+    AgentStream(const AgentStream&) = delete;
+    AgentStream& operator=(const AgentStream&) = delete;
+
+    bool start(const std::string& address) {
+        if (!resolveAddress(address, false, address_)) {
+            std::cerr << "Error: Invalid aggregator address " << address << std::endl;
+            return false;
+        }
+        flush();
+        return true;
+    }
+
+    // Queues one sample; a full batch becomes a frame and is sent.
+    void push(const SampleRecord& record) {
+        records_.push_back(record);
+        if (records_.size() >= batch_) {
+            enqueueFrame();
+            records_.clear();
+        }
+        flush();
+    }
+
+    // Connects if needed and sends as much queued data as the socket takes.
+    void flush() {
+        if (fd_ < 0 && !connect())
+            return;
+        if (connecting_ && !finishConnect())
+            return;
+        while (!pending_.empty()) {
+            ssize_t n = send(fd_, pending_.data(), pending_.size(), MSG_NOSIGNAL);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+                return;
+            if (n <= 0) {
+                disconnect();
+                return;
+            }
+            consume(static_cast<size_t>(n));
+        }
+    }
+
+    bool connected() const { return fd_ >= 0 && !connecting_; }
+    unsigned long long frames() const { return frames_; }
+    unsigned long long samplesSent() const { return sent_; }
+    unsigned long long samplesDropped() const { return dropped_; }
+    unsigned long long reconnects() const { return reconnects_; }
+
+private:
+    static const size_t kMaxPendingBytes = 256 * 1024;
+    static_assert(kMaxPendingBytes / 4 <= kMaxFrameBytes, "a full batch must fit in one frame");
+
+    struct QueuedFrame {
+        size_t bytes;
+        size_t samples;
+    };
+
+    void enqueueFrame() {
+        size_t bytes = sizeof(FrameHeader) + host_.size() + records_.size() * sizeof(SampleRecord);
+        if (pending_.size() + bytes > kMaxPendingBytes) {
+            dropped_ += records_.size();
+            return;
+        }
+        FrameHeader h;
+        h.length = static_cast<uint32_t>(bytes - sizeof(h.length));
+        std::memcpy(h.magic, kFrameMagic, sizeof(h.magic));
+        h.hostLength = static_cast<uint16_t>(host_.size());
+        h.reserved = 0;
+        h.count = static_cast<uint32_t>(records_.size());
+        h.intervalMs = intervalMs_;
+        pending_.append(reinterpret_cast<const char*>(&h), sizeof(h));
+        pending_.append(host_);
+        pending_.append(reinterpret_cast<const char*>(records_.data()), records_.size() * sizeof(SampleRecord));
+        QueuedFrame f = {bytes, records_.size()};
+        queued_.push_back(f);
+        ++frames_;
+    }
+
+    // Drops n sent bytes from the front, retiring whole frames.
+    void consume(size_t n) {
+        pending_.erase(0, n);
+        frontSent_ += n;
+        while (!queued_.empty() && frontSent_ >= queued_.front().bytes) {
+            frontSent_ -= queued_.front().bytes;
+            sent_ += queued_.front().samples;
+            queued_.pop_front();
+        }
+    }
+
+    bool connect() {
+        int64_t now = fleetClockNs();
+        if (now < nextAttemptNs_)
+            return false;
+        nextAttemptNs_ = now + 1000000000LL;
+        fd_ = socket(address_.family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd_ < 0)
+            return false;
+        if (::connect(fd_, reinterpret_cast<const struct sockaddr*>(&address_.addr), address_.length) == 0) {
+            connecting_ = false;
+            ++reconnects_;
+            return true;
+        }
+        if (errno == EINPROGRESS) {
+            connecting_ = true;
+            return true;
+        }
+        close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    bool finishConnect() {
+        struct pollfd pfd;
+        pfd.fd = fd_;
+        pfd.events = POLLOUT;
+        if (poll(&pfd, 1, 0) <= 0)
+            return false; // still in progress
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &len) != 0 || error != 0) {
+            disconnect();
+            return false;
+        }
+        connecting_ = false;
+        ++reconnects_;
+        return true;
+    }
+
+    // A frame cut off mid-way cannot be resumed on a new connection, so it
+    // is dropped; complete frames still queued are sent after reconnecting.
+    void disconnect() {
+        close(fd_);
+        fd_ = -1;
+        connecting_ = false;
+        if (frontSent_ > 0 && !queued_.empty()) {
+            pending_.erase(0, queued_.front().bytes - frontSent_);
+            dropped_ += queued_.front().samples;
+            queued_.pop_front();
+            frontSent_ = 0;
+        }
+    }
+
+    std::string host_;
+    uint32_t intervalMs_;
+    size_t batch_;
+    SocketAddress address_;
+    int fd_;
+    bool connecting_;
+    int64_t nextAttemptNs_;
+    std::vector<SampleRecord> records_;
+    std::string pending_;
+    std::deque<QueuedFrame> queued_;
+    size_t frontSent_; // bytes of the front frame already sent
+    unsigned long long frames_;
+    unsigned long long sent_;
+    unsigned long long dropped_;
+    unsigned long long reconnects_;
+};
+
+const int kFleetMetrics = 3;
+const char* const kFleetMetricLabels[kFleetMetrics] = {"CPU", "RAM", "Disk"};
+
+struct HostStats {
+    std::string name;
+    int connections; // open agent connections under this name
+    std::chrono::milliseconds interval;
+    unsigned long long frames;
+    unsigned long long samples;
+    int64_t lastTimestampNs; // agent's wall clock
+    int64_t lastSeenNs;      // aggregator's monotonic clock
+    MetricState cpu;
+    MetricState ram;
+    MetricState disk;
+
+    HostStats(const std::string& hostName, std::chrono::milliseconds sampleInterval)
+        : name(hostName), connections(0), interval(sampleInterval), frames(0), samples(0), lastTimestampNs(0),
+          lastSeenNs(0), cpu(sampleInterval), ram(sampleInterval), disk(sampleInterval) {}
+
+    // MetricState is cache-line aligned; plain C++11 new only guarantees
+    // alignof(max_align_t).
+    static void* operator new(size_t size) {
+        void* p = nullptr;
+        if (posix_memalign(&p, alignof(HostStats), size) != 0)
+            throw std::bad_alloc();
+        return p;
+    }
+    static void operator delete(void* p) { free(p); }
+
+    // 0, 1, 2 for CPU, RAM, disk, as in kFleetMetricLabels.
+    const MetricState& metric(int m) const { return m == 0 ? cpu : (m == 1 ? ram : disk); }
+
+    void record(const SampleRecord& r) {
+        cpu.record(r.cpu);
+        ram.record(r.ram);
+        disk.record(r.disk);
+        lastTimestampNs = r.timestampNs;
+        ++samples;
+    }
+};
+
+// One metric over one window, across every host with samples in it.
+struct FleetSummary {
+    size_t hosts;
+    size_t samples;
+    double average; // sample-weighted
+    double min;
+    double max;
+    const HostStats* maxHost;
+};
+
+class FleetAggregator {
+public:
+    FleetAggregator() : listenFd_(-1), epfd_(-1), timerFd_(-1), bytes_(0), frames_(0), errors_(0) {}
+
+    ~FleetAggregator() {
+        for (std::unordered_map<int, Connection>::iterator it = connections_.begin(); it != connections_.end(); ++it)
+            close(it->first);
+        if (listenFd_ >= 0)
+            close(listenFd_);
+        if (epfd_ >= 0)
+            close(epfd_);
+        if (timerFd_ >= 0)
+            close(timerFd_);
+        if (!unixPath_.empty())
+            unlink(unixPath_.c_str());
+    }
+
+    FleetAggregator(const FleetAggregator&) = delete;
+    FleetAggregator& operator=(const FleetAggregator&) = delete;
+
+    bool start(const std::string& address) {
+        SocketAddress a;
+        if (!resolveAddress(address, true, a)) {
+            std::cerr << "Error: Invalid listen address " << address << std::endl;
+            return false;
+        }
+        listenFd_ = socket(a.family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd_ < 0) {
+            std::cerr << "Error: Unable to create aggregator socket." << std::endl;
+            return false;
+        }
+        if (a.family == AF_UNIX) {
+            unixPath_ = address.substr(5);
+            unlink(unixPath_.c_str()); // a stale socket from a previous run
+        } else {
+            int on = 1;
+            setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        }
+        if (bind(listenFd_, reinterpret_cast<struct sockaddr*>(&a.addr), a.length) != 0 ||
+            listen(listenFd_, 128) != 0) {
+            std::cerr << "Error: Unable to listen on " << address << "." << std::endl;
+            return false;
+        }
+        epfd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epfd_ < 0 || !watch(listenFd_)) {
+            std::cerr << "Error: Unable to set up aggregator." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Serves agents forever, calling onReport() every reportInterval.
+    // Returns false on a fatal error.
+    template <typename F>
+    bool run(std::chrono::milliseconds reportInterval, F onReport) {
+        timerFd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        struct itimerspec spec;
+        spec.it_interval.tv_sec = reportInterval.count() / 1000;
+        spec.it_interval.tv_nsec = (reportInterval.count() % 1000) * 1000000L;
+        spec.it_value = spec.it_interval;
+        if (timerFd_ < 0 || timerfd_settime(timerFd_, 0, &spec, nullptr) != 0 || !watch(timerFd_)) {
+            std::cerr << "Error: Unable to create report timer." << std::endl;
+            return false;
+        }
+        struct epoll_event events[64];
+        while (true) {
+            int n = epoll_wait(epfd_, events, 64, -1);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                std::cerr << "Error: Aggregator epoll_wait failed." << std::endl;
+                return false;
+            }
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == listenFd_) {
+                    acceptAll();
+                } else if (fd == timerFd_) {
+                    uint64_t expirations;
+                    if (::read(timerFd_, &expirations, sizeof(expirations)) == sizeof(expirations))
+                        onReport();
+                } else {
+                    ingest(fd);
+                }
+            }
+        }
+    }
+
+    size_t hosts() const { return hosts_.size(); }
+    const HostStats& host(size_t i) const { return *hosts_[i]; }
+    size_t connections() const { return connections_.size(); }
+    unsigned long long bytes() const { return bytes_; }
+    unsigned long long frames() const { return frames_; }
+    unsigned long long protocolErrors() const { return errors_; }
+
+    // window: 0, 1, 2 for 1m, 5m, 15m.
+    FleetSummary summary(int metric, int window) const {
+        FleetSummary s = {0, 0, 0.0, 0.0, 0.0, nullptr};
+        double sum = 0.0;
+        for (size_t i = 0; i < hosts_.size(); ++i) {
+            const LoadWindows& w = hosts_[i]->metric(metric).windows;
+            const size_t ids[3] = {w.oneMinute, w.fiveMinutes, w.fifteenMinutes};
+            WindowSummary h = w.history.summary(ids[window]);
+            if (h.count == 0)
+                continue;
+            if (s.hosts == 0 || h.min < s.min)
+                s.min = h.min;
+            if (s.hosts == 0 || h.max > s.max) {
+                s.max = h.max;
+                s.maxHost = hosts_[i].get();
+            }
+            sum += h.average * h.count;
+            s.samples += h.count;
+            ++s.hosts;
+        }
+        s.average = s.samples ? sum / s.samples : 0.0;
+        return s;
+    }
+
+    // Percentiles over every sample from every host since start.
+    UsagePercentiles percentiles(int metric) const {
+        UsagePercentiles merged;
+        for (size_t i = 0; i < hosts_.size(); ++i)
+            merged.merge(hosts_[i]->metric(metric).percentiles);
+        return merged;
+    }
+
+private:
+    static const size_t kMaxConnections = 1024;
+
+    struct Connection {
+        std::string buffer;
+        int host; // index into hosts_, -1 until the first frame
+    };
+
+    bool watch(int fd) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        return epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) == 0;
+    }
+
+    void acceptAll() {
+        while (true) {
+            int fd = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+                return;
+            if (connections_.size() >= kMaxConnections || !watch(fd)) {
+                close(fd);
+                continue;
+            }
+            connections_[fd].host = -1;
+        }
+    }
+
+    void drop(int fd) {
+        std::unordered_map<int, Connection>::iterator it = connections_.find(fd);
+        if (it != connections_.end()) {
+            if (it->second.host >= 0)
+                --hosts_[it->second.host]->connections;
+            connections_.erase(it);
+        }
+        close(fd);
+    }
+
+    // Level-triggered: read what is there, parse every complete frame.
+    void ingest(int fd) {
+        std::unordered_map<int, Connection>::iterator it = connections_.find(fd);
+        if (it == connections_.end())
+            return;
+        Connection& c = it->second;
+        char chunk[65536];
+        ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            return;
+        if (n <= 0) {
+            drop(fd);
+            return;
+        }
+        bytes_ += static_cast<unsigned long long>(n);
+        c.buffer.append(chunk, static_cast<size_t>(n));
+
+        size_t pos = 0;
+        while (c.buffer.size() - pos >= sizeof(uint32_t)) {
+            uint32_t length;
+            std::memcpy(&length, c.buffer.data() + pos, sizeof(length));
+            if (length < sizeof(FrameHeader) - sizeof(uint32_t) || length > kMaxFrameBytes) {
+                ++errors_;
+                drop(fd);
+                return;
+            }
+            if (c.buffer.size() - pos < sizeof(uint32_t) + length)
+                break;
+            if (!frame(c, c.buffer.data() + pos, sizeof(uint32_t) + length)) {
+                ++errors_;
+                drop(fd);
+                return;
+            }
+            pos += sizeof(uint32_t) + length;
+        }
+        c.buffer.erase(0, pos);
+    }
+
+    bool frame(Connection& c, const char* data, size_t size) {
+        FrameHeader h;
+        std::memcpy(&h, data, sizeof(h));
+        if (std::memcmp(h.magic, kFrameMagic, sizeof(h.magic)) != 0 || h.hostLength == 0 ||
+            sizeof(h) + h.hostLength + static_cast<size_t>(h.count) * sizeof(SampleRecord) != size)
+            return false;
+        std::string name(data + sizeof(h), h.hostLength);
+        if (c.host < 0 || hosts_[c.host]->name != name) {
+            if (c.host >= 0)
+                --hosts_[c.host]->connections;
+            c.host = hostIndex(name, std::chrono::milliseconds(h.intervalMs > 0 ? h.intervalMs : 1000));
+            ++hosts_[c.host]->connections;
+        }
+        HostStats& host = *hosts_[c.host];
+        const char* p = data + sizeof(h) + h.hostLength;
+        for (uint32_t i = 0; i < h.count; ++i, p += sizeof(SampleRecord)) {
+            SampleRecord r;
+            std::memcpy(&r, p, sizeof(r));
+            host.record(r);
+        }
+        ++host.frames;
+        host.lastSeenNs = fleetClockNs();
+        ++frames_;
+        return true;
+    }
+
+    int hostIndex(const std::string& name, std::chrono::milliseconds interval) {
+        std::unordered_map<std::string, int>::iterator it = hostIds_.find(name);
+        if (it != hostIds_.end())
+            return it->second;
+        hosts_.push_back(std::unique_ptr<HostStats>(new HostStats(name, interval)));
+        int id = static_cast<int>(hosts_.size() - 1);
+        hostIds_[name] = id;
+        return id;
+    }
+
+    int listenFd_;
+    int epfd_;
+    int timerFd_;
+    std::string unixPath_;
+    std::unordered_map<int, Connection> connections_;
+    std::vector<std::unique_ptr<HostStats>> hosts_;
+    std::unordered_map<std::string, int> hostIds_;
+    unsigned long long bytes_;
+    unsigned long long frames_;
+    unsigned long long errors_;
+};
+
+#endif
@@ -0,0 +1,308 @@
+#ifndef GORILLA_H
+#define GORILLA_H
+
+// Gorilla-style compression (Pelkonen et al., VLDB 2015) for blocks of
+// SampleRecords. Timestamps are stored as delta-of-deltas and each metric as
+// the XOR with its previous value, so slowly changing series cost a few bits
+// per sample. Values round-trip bit-exactly; timestamps are kept at
+// millisecond resolution, which keeps the usual sub-millisecond report
+// jitter out of the delta-of-delta stream.
+//
+// Block layout: 32-bit little-endian sample count, then the bit stream,
+// packed most significant bit first into bytes. The layout does not depend
+// on the host's byte order.
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "bit_ops.h"
+#include "sample_log.h"
+
+class BitWriter {
+public:
+    BitWriter() : acc_(0), used_(0) {}
+
+    // Appends the low n bits of value, most significant first. n <= 64.
+    void write(uint64_t value, unsigned n) {
+        if (n == 0)
+            return;
+        if (n < 64)
+            value &= (1ULL << n) - 1;
+        unsigned room = 64 - used_;
+        if (n <= room) {
+            acc_ |= value << (room - n);
+            used_ += n;
+            if (used_ == 64)
+                flushWord();
+        } else {
+            unsigned rest = n - room;
+            acc_ |= value >> rest;
+            used_ = 64;
+            flushWord();
+            acc_ = value << (64 - rest);
+            used_ = rest;
+        }
+    }
+
+    void writeBit(bool bit) { write(bit ? 1 : 0, 1); }
+
+    // Flushes the partial word; the writer must not be used afterwards.
+    std::vector<uint8_t>& finish() {
+        for (unsigned i = 0; i < (used_ + 7) / 8; ++i)
+            bytes_.push_back(static_cast<uint8_t>(acc_ >> (56 - 8 * i)));
+        acc_ = 0;
+        used_ = 0;
+        return bytes_;
+    }
+
+    std::vector<uint8_t>& bytes() { return bytes_; }
+
+private:
+    void flushWord() {
+        size_t at = bytes_.size();
+        bytes_.resize(at + 8);
+        storeBigEndian64(&bytes_[at], acc_);
+        acc_ = 0;
+        used_ = 0;
+    }
+
+    std::vector<uint8_t> bytes_;
+    uint64_t acc_;
+    unsigned used_;
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : data_(data), size_(size), pos_(0) {}
+
+    // Reads n <= 64 bits. Past the end, zeros are returned and ok() fails.
+    uint64_t read(unsigned n) {
+        if (n > 56)
+            return (read(n - 32) << 32) | read(32);
+        if (n == 0)
+            return 0;
+        size_t byte = pos_ >> 3;
+        unsigned shift = static_cast<unsigned>(pos_ & 7);
+        uint64_t window = 0;
+        if (byte + 8 <= size_) {
+            window = loadBigEndian64(data_ + byte);
+        } else {
+            for (int i = 0; i < 8; ++i) {
+                window <<= 8;
+                if (byte + i < size_)
+                    window |= data_[byte + i];
+            }
+        }
+        pos_ += n;
+        return (window << shift) >> (64 - n);
+    }
+
+    bool readBit() { return read(1) != 0; }
+    bool ok() const { return pos_ <= size_ * 8; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_;
+};
+
+// XOR encoder state for one double series.
+struct XorChannel {
+    uint64_t prev;
+    unsigned leading;
+    unsigned trailing;
+
+    XorChannel() : prev(0), leading(~0u), trailing(0) {}
+
+    void encode(BitWriter& out, double value, bool first) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        if (first) {
+            out.write(bits, 64);
+            prev = bits;
+            return;
+        }
+
+        uint64_t x = bits ^ prev;
+        prev = bits;
+        if (x == 0) {
+            out.writeBit(false);
+            return;
+        }
+        out.writeBit(true);
+
+        unsigned lead = static_cast<unsigned>(leadingZeros64(x));
+        unsigned trail = static_cast<unsigned>(trailingZeros64(x));
+        if (lead > 31)
+            lead = 31; // the leading-zero count has a 5-bit field
+
+        if (leading != ~0u && lead >= leading && trail >= trailing) {
+            // Fits inside the previous meaningful-bit window.
+            out.writeBit(false);
+            out.write(x >> trailing, 64 - leading - trailing);
+        } else {
+            unsigned meaningful = 64 - lead - trail;
+            out.writeBit(true);
+            out.write(lead, 5);
+            out.write(meaningful & 63, 6); // 64 is stored as 0
+            out.write(x >> trail, meaningful);
+            leading = lead;
+            trailing = trail;
+        }
+    }
+
+    double decode(BitReader& in, bool first) {
+        if (first) {
+            prev = in.read(64);
+        } else if (in.readBit()) {
+            if (in.readBit()) {
+                leading = static_cast<unsigned>(in.read(5));
+                unsigned meaningful = static_cast<unsigned>(in.read(6));
+                if (meaningful == 0)
+                    meaningful = 64;
+                trailing = 64 - leading - meaningful;
+            }
+            unsigned meaningful = 64 - leading - trailing;
+            prev ^= in.read(meaningful) << trailing;
+        }
+        double value;
+        std::memcpy(&value, &prev, sizeof(value));
+        return value;
+    }
+};
+
+class GorillaEncoder {
+public:
+    GorillaEncoder() : count_(0), prevTs_(0), prevDelta_(0) {
+        for (int i = 0; i < 4; ++i)
+            out_.bytes().push_back(0); // count, patched in finish()
+    }
+
+    void append(const SampleRecord& record) {
+        int64_t ts = record.timestampNs / 1000000;
+        bool first = count_ == 0;
+        if (first) {
+            out_.write(static_cast<uint64_t>(ts), 64);
+        } else {
+            int64_t delta = ts - prevTs_;
+            encodeDeltaOfDelta(delta - prevDelta_);
+            prevDelta_ = delta;
+        }
+        prevTs_ = ts;
+
+        cpu_.encode(out_, record.cpu, first);
+        ram_.encode(out_, record.ram, first);
+        disk_.encode(out_, record.disk, first);
+        ++count_;
+    }
+
+    uint32_t count() const { return count_; }
+
+    // Returns the finished block; the encoder must not be reused.
+    std::vector<uint8_t>& finish() {
+        std::vector<uint8_t>& bytes = out_.finish();
+        for (int i = 0; i < 4; ++i)
+            bytes[i] = static_cast<uint8_t>(count_ >> (8 * i));
+        return bytes;
+    }
+
+private:
+    void encodeDeltaOfDelta(int64_t dod) {
+        uint64_t u = static_cast<uint64_t>(dod);
+        if (dod == 0) {
+            out_.writeBit(false);
+        } else if (dod >= -63 && dod <= 64) {
+            out_.write(0x2, 2);
+            out_.write(u, 7);
+        } else if (dod >= -255 && dod <= 256) {
+            out_.write(0x6, 3);
+            out_.write(u, 9);
+        } else if (dod >= -2047 && dod <= 2048) {
+            out_.write(0xE, 4);
+            out_.write(u, 12);
+        } else {
+            out_.write(0xF, 4);
+            out_.write(u, 64);
+        }
+    }
+
+    BitWriter out_;
+    uint32_t count_;
+    int64_t prevTs_;
+    int64_t prevDelta_;
+    XorChannel cpu_;
+    XorChannel ram_;
+    XorChannel disk_;
+};
+
+class GorillaDecoder {
+public:
+    GorillaDecoder(const uint8_t* data, size_t size)
+        : in_(data + (size >= 4 ? 4 : size), size >= 4 ? size - 4 : 0), count_(0), read_(0), prevTs_(0),
+          prevDelta_(0) {
+        if (size >= 4)
+            count_ = static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 |
+                     static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+    }
+
+    uint32_t count() const { return count_; }
+
+    bool next(SampleRecord& record) {
+        if (read_ >= count_)
+            return false;
+        bool first = read_ == 0;
+        int64_t ts;
+        if (first) {
+            ts = static_cast<int64_t>(in_.read(64));
+        } else {
+            int64_t delta = prevDelta_ + decodeDeltaOfDelta();
+            ts = prevTs_ + delta;
+            prevDelta_ = delta;
+        }
+        prevTs_ = ts;
+
+        record.timestampNs = ts * 1000000;
+        record.cpu = cpu_.decode(in_, first);
+        record.ram = ram_.decode(in_, first);
+        record.disk = disk_.decode(in_, first);
+        ++read_;
+        return in_.ok();
+    }
+
+private:
+    static int64_t signExtend(uint64_t v, unsigned bits) {
+        uint64_t sign = 1ULL << (bits - 1);
+        return static_cast<int64_t>((v ^ sign) - sign);
+    }
+
+    int64_t decodeDeltaOfDelta() {
+        if (!in_.readBit())
+            return 0;
+        if (!in_.readBit())
+            return fromRange(in_.read(7), 7, 64);
+        if (!in_.readBit())
+            return fromRange(in_.read(9), 9, 256);
+        if (!in_.readBit())
+            return fromRange(in_.read(12), 12, 2048);
+        return static_cast<int64_t>(in_.read(64));
+    }
+
+    // The ranges are [-(2^(bits-1)-1), 2^(bits-1)]: the top positive value
+    // shares its bit pattern with -2^(bits-1), which is never written.
+    static int64_t fromRange(uint64_t v, unsigned bits, int64_t top) {
+        int64_t s = signExtend(v, bits);
+        return s == -top ? top : s;
+    }
+
+    BitReader in_;
+    uint32_t count_;
+    uint32_t read_;
+    int64_t prevTs_;
+    int64_t prevDelta_;
+    XorChannel cpu_;
+    XorChannel ram_;
+    XorChannel disk_;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "gorilla.h"
+#include "sample_log.h"
+
+using namespace std;
+using namespace chrono;
+
+// Slowly changing series shaped like real samples: CPU from integer jiffy
+// ratios, RAM from kB counts, disk nearly constant, 1s apart with jitter.
+vector<SampleRecord> syntheticSeries(size_t n) {
+    mt19937_64 rng(42);
+    normal_distribution<double> jitter(0.0, 200000.0); // ns
+    uniform_int_distribution<int> busy(0, 40);
+    vector<SampleRecord> series(n);
+    long long ramUsedKB = 3000000;
+    const long long ramTotalKB = 16000000;
+    long long diskUsed = 1000000;
+    const long long diskTotal = 14000000;
+    int64_t ts = 1700000000LL * 1000000000LL;
+    for (size_t i = 0; i < n; ++i) {
+        ts += 1000000000LL;
+        ramUsedKB += static_cast<long long>(rng() % 2001) - 1000;
+        if (rng() % 30 == 0)
+            ++diskUsed;
+        series[i].timestampNs = ts + static_cast<int64_t>(jitter(rng));
+        series[i].cpu = (busy(rng) / 400.0) * 100.0;
+        series[i].ram = (static_cast<double>(ramUsedKB) / ramTotalKB) * 100.0;
+        series[i].disk = ((static_cast<double>(diskTotal) - (diskTotal - diskUsed)) / diskTotal) * 100.0;
+    }
+    return series;
+}
+
+int main(int argc, char* argv[]) {
+    size_t blockSize = 3600;
+    size_t samples = 1000000;
+    const char* logPath = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--block") == 0 && i + 1 < argc)
+            blockSize = static_cast<size_t>(atoll(argv[++i]));
+        else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+            samples = static_cast<size_t>(atoll(argv[++i]));
+        else
+            logPath = argv[i];
+    }
+    if (blockSize == 0)
+        blockSize = 1;
+
+    vector<SampleRecord> series;
+    if (logPath) {
+        SampleLogReader log;
+        if (!log.open(logPath)) {
+            cerr << "Error: Could not read sample log " << logPath << endl;
+            return 1;
+        }
+        for (size_t i = 0; i < log.size(); ++i)
+            series.push_back(log[i]);
+    } else {
+        series = syntheticSeries(samples);
+    }
+    if (series.empty()) {
+        cerr << "Error: No samples to encode." << endl;
+        return 1;
+    }
+
+    auto encodeStart = steady_clock::now();
+    vector<vector<uint8_t>> blocks;
+    for (size_t i = 0; i < series.size(); i += blockSize) {
+        GorillaEncoder encoder;
+        size_t end = min(series.size(), i + blockSize);
+        for (size_t j = i; j < end; ++j)
+            encoder.append(series[j]);
+        blocks.push_back(std::move(encoder.finish()));
+    }
+    auto encodeEnd = steady_clock::now();
+
+    size_t decoded = 0, mismatches = 0;
+    double checksum = 0.0;
+    auto decodeStart = steady_clock::now();
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        GorillaDecoder decoder(blocks[b].data(), blocks[b].size());
+        SampleRecord r;
+        while (decoder.next(r)) {
+            const SampleRecord& orig = series[decoded];
+            if (r.timestampNs != (orig.timestampNs / 1000000) * 1000000 ||
+                memcmp(&r.cpu, &orig.cpu, 3 * sizeof(double)) != 0)
+                ++mismatches;
+            checksum += r.cpu;
+            ++decoded;
+        }
+    }
+    auto decodeEnd = steady_clock::now();
+
+    size_t bytes = 0;
+    for (size_t b = 0; b < blocks.size(); ++b)
+        bytes += blocks[b].size();
+
+    double encodeSec = duration<double>(encodeEnd - encodeStart).count();
+    double decodeSec = duration<double>(decodeEnd - decodeStart).count();
+    double n = static_cast<double>(series.size());
+
+    printf("samples:            %zu (%s)\n", series.size(), logPath ? logPath : "synthetic");
+    printf("block size:         %zu samples, %zu blocks\n", blockSize, blocks.size());
+    printf("raw bytes/sample:   %zu\n", sizeof(SampleRecord));
+    printf("bytes/sample:       %.3f (ratio %.2fx)\n", bytes / n, sizeof(SampleRecord) * n / bytes);
+    printf("encode:             %.1f M samples/s, %.1f ns/sample\n", n / encodeSec / 1e6, encodeSec * 1e9 / n);
+    printf("decode:             %.1f M samples/s, %.1f ns/sample\n", n / decodeSec / 1e6, decodeSec * 1e9 / n);
+    printf("round trip:         %s (%zu decoded, %zu mismatches, checksum %.3f)\n",
+           decoded == series.size() && mismatches == 0 ? "ok" : "FAILED", decoded, mismatches, checksum);
+    return decoded == series.size() && mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+#ifndef HIGH_FREQUENCY_H
+#define HIGH_FREQUENCY_H
+
+// High-frequency CPU sampling and self-overhead accounting.
+//
+// BurstSampler reads the aggregate /proc/stat line every few milliseconds
+// into a preallocated buffer; the report drains it into one summary per
+// report interval, so short bursts that a 1s average flattens show up in
+// the max and the upper percentiles. /proc/stat counts in clock ticks
+// (usually 10ms), so a sample only exists once at least one tick has
+// elapsed; reads that see no new ticks are skipped rather than recorded
+// as idle.
+//
+// SelfOverhead measures the monitor's own CPU time (all threads) against
+// wall time, to keep the cost of observing visible in the report.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include "proc_backend.h"
+
+struct BurstSummary {
+    size_t count;   // samples in the interval
+    size_t dropped; // samples lost because the buffer was full
+    double average;
+    double min;
+    double max;
+    double p50;
+    double p99;
+};
+
+class BurstSampler {
+public:
+    // capacity should cover one report interval of samples, with slack.
+    explicit BurstSampler(size_t capacity) : dropped_(0), primed_(false) {
+        samples_.reserve(capacity > 0 ? capacity : 1);
+    }
+
+    // One fast tick: no allocation, one pread.
+    bool sample() {
+        if (!cpu_.stat.read() || std::strncmp(cpu_.stat.buf, "cpu ", 4) != 0)
+            return false;
+        CpuTimes now;
+        if (!parseCpuLine(cpu_.stat.buf + 3, now))
+            return false;
+        if (now.total == cpu_.prev.total)
+            return true; // no tick elapsed since the last read
+
+        double busy = static_cast<double>(now.busy - cpu_.prev.busy);
+        double total = static_cast<double>(now.total - cpu_.prev.total);
+        cpu_.prev = now;
+        if (!primed_) {
+            primed_ = true; // the first delta spans everything since boot
+            return true;
+        }
+        if (samples_.size() < samples_.capacity())
+            samples_.push_back(busy / total * 100.0);
+        else
+            ++dropped_;
+        return true;
+    }
+
+    // Aggregates the samples taken since the previous drain and starts a
+    // new interval. Reorders the buffer in place; nothing is copied.
+    BurstSummary drain() {
+        BurstSummary s = {samples_.size(), dropped_, 0.0, 0.0, 0.0, 0.0, 0.0};
+        if (!samples_.empty()) {
+            double sum = 0.0;
+            s.min = s.max = samples_[0];
+            for (size_t i = 0; i < samples_.size(); ++i) {
+                sum += samples_[i];
+                s.min = std::min(s.min, samples_[i]);
+                s.max = std::max(s.max, samples_[i]);
+            }
+            s.average = sum / samples_.size();
+            s.p50 = select(0.50);
+            s.p99 = select(0.99);
+        }
+        samples_.clear();
+        dropped_ = 0;
+        return s;
+    }
+
+private:
+    // Nearest rank, as in HdrHistogram::quantile: the ceil(q * n)-th
+    // smallest sample, so p99 of fewer than 100 samples is the max.
+    double select(double q) {
+        size_t n = samples_.size();
+        size_t rank = static_cast<size_t>(std::ceil(q * n - 1e-9));
+        size_t k = std::min(std::max<size_t>(rank, 1), n) - 1;
+        std::nth_element(samples_.begin(), samples_.begin() + k, samples_.end());
+        return samples_[k];
+    }
+
+    CpuSampler cpu_;
+    std::vector<double> samples_;
+    size_t dropped_;
+    bool primed_;
+};
+
+class SelfOverhead {
+public:
+    SelfOverhead() : startCpuNs_(cpuNs()), startWallNs_(wallNs()), prevCpuNs_(startCpuNs_), prevWallNs_(startWallNs_),
+                     cpuMsPerSec_(0.0), totalCpuMsPerSec_(0.0) {}
+
+    // Call once per report; figures cover the time since the previous call
+    // and since construction.
+    void sample() {
+        long long cpu = cpuNs();
+        long long wall = wallNs();
+        if (wall > prevWallNs_)
+            cpuMsPerSec_ = static_cast<double>(cpu - prevCpuNs_) / (wall - prevWallNs_) * 1000.0;
+        if (wall > startWallNs_)
+            totalCpuMsPerSec_ = static_cast<double>(cpu - startCpuNs_) / (wall - startWallNs_) * 1000.0;
+        prevCpuNs_ = cpu;
+        prevWallNs_ = wall;
+    }
+
+    // CPU milliseconds used per wall-clock second; 10 ms/s is 1% of a core.
+    double cpuMsPerSecond() const { return cpuMsPerSec_; }
+    double totalCpuMsPerSecond() const { return totalCpuMsPerSec_; }
+    double percentOfCore() const { return cpuMsPerSec_ / 10.0; }
+    double totalPercentOfCore() const { return totalCpuMsPerSec_ / 10.0; }
+    double cpuSeconds() const { return (prevCpuNs_ - startCpuNs_) / 1e9; }
+
+private:
+    static long long read(clockid_t clock) {
+        struct timespec ts;
+        clock_gettime(clock, &ts);
+        return static_cast<long long>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+    static long long cpuNs() { return read(CLOCK_PROCESS_CPUTIME_ID); }
+    static long long wallNs() { return read(CLOCK_MONOTONIC); }
+
+    long long startCpuNs_;
+    long long startWallNs_;
+    long long prevCpuNs_;
+    long long prevWallNs_;
+    double cpuMsPerSec_;
+    double totalCpuMsPerSec_;
+};
+
+#endif
@@ -0,0 +1,212 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+// Latency histograms for the monitor's own stages (collectors, report
+// rendering, report writes).
+//
+// Stages are registered by name once, at setup. Each thread records into
+// its own table of per-stage counters: the owning thread is the only
+// writer, so an update is a relaxed load and store with no lock and no
+// read-modify-write. Readers on any thread merge all tables (plus the
+// totals of threads that have exited) without stopping the writers; a
+// merge may be a few samples behind, never torn within one counter.
+// Only thread start and exit take the registry mutex.
+
+#include <atomic>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <vector>
+
+#include "hdr_histogram.h"
+
+// Nanoseconds, 1/16 relative bucket width, up to ~18 minutes.
+typedef HdrHistogram<5, 40> LatencyHistogram;
+
+struct StageLatency {
+    unsigned long long calls;
+    unsigned long long totalNs;
+    unsigned long long maxNs;
+    LatencyHistogram histogram;
+};
+
+inline unsigned long long stageClockNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + static_cast<unsigned long long>(ts.tv_nsec);
+}
+
+class StageRegistry {
+public:
+    static const int kMaxStages = 16;
+
+    // One thread's counters.
+    class ThreadTable {
+    public:
+        ThreadTable() { std::memset(static_cast<void*>(slots_), 0, sizeof(slots_)); }
+
+        void record(int stage, unsigned long long ns) {
+            Slot& s = slots_[stage];
+            bump(s.calls, 1);
+            bump(s.totalNs, ns);
+            if (ns > s.maxNs.load(std::memory_order_relaxed))
+                s.maxNs.store(ns, std::memory_order_relaxed);
+            bump(s.buckets[LatencyHistogram::bucketOf(ns)], 1);
+        }
+
+        void addTo(int stage, StageLatency& out) const {
+            const Slot& s = slots_[stage];
+            out.calls += s.calls.load(std::memory_order_relaxed);
+            out.totalNs += s.totalNs.load(std::memory_order_relaxed);
+            unsigned long long maxNs = s.maxNs.load(std::memory_order_relaxed);
+            if (maxNs > out.maxNs)
+                out.maxNs = maxNs;
+            for (size_t b = 0; b < LatencyHistogram::kBuckets; ++b) {
+                unsigned long long n = s.buckets[b].load(std::memory_order_relaxed);
+                if (n)
+                    out.histogram.add(b, n);
+            }
+        }
+
+    private:
+        struct Slot {
+            std::atomic<unsigned long long> calls;
+            std::atomic<unsigned long long> totalNs;
+            std::atomic<unsigned long long> maxNs;
+            std::atomic<unsigned long long> buckets[LatencyHistogram::kBuckets];
+        };
+
+        // Single writer: a plain load and store, no locked instruction.
+        static void bump(std::atomic<unsigned long long>& counter, unsigned long long n) {
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        Slot slots_[kMaxStages];
+    };
+
+    // Returns the id for name, registering it if needed; -1 once full.
+    int stage(const char* name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < names_.size(); ++i) {
+            if (std::strcmp(names_[i], name) == 0)
+                return static_cast<int>(i);
+        }
+        if (names_.size() == static_cast<size_t>(kMaxStages))
+            return -1;
+        names_.push_back(name);
+        return static_cast<int>(names_.size() - 1);
+    }
+
+    size_t stages() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return names_.size();
+    }
+
+    const char* name(int stage) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return names_[stage];
+    }
+
+    StageLatency latency(int stage) {
+        StageLatency out;
+        out.calls = 0;
+        out.totalNs = 0;
+        out.maxNs = 0;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < threads_.size(); ++i)
+            threads_[i]->addTo(stage, out);
+        retired_.addTo(stage, out);
+        out.histogram.capMax(out.maxNs);
+        return out;
+    }
+
+    void record(int stage, unsigned long long ns) {
+        if (stage >= 0)
+            local().table.record(stage, ns);
+    }
+
+private:
+    // Registers on a thread's first record and folds its counts into
+    // retired_ when the thread exits.
+    struct Local {
+        ThreadTable table;
+        StageRegistry* registry;
+
+        explicit Local(StageRegistry* r) : registry(r) {
+            std::lock_guard<std::mutex> lock(registry->mutex_);
+            registry->threads_.push_back(&table);
+        }
+
+        ~Local() {
+            std::lock_guard<std::mutex> lock(registry->mutex_);
+            for (size_t s = 0; s < registry->names_.size(); ++s) {
+                StageLatency l;
+                l.calls = l.totalNs = l.maxNs = 0;
+                table.addTo(static_cast<int>(s), l);
+                registry->retired_.absorb(static_cast<int>(s), l);
+            }
+            for (size_t i = 0; i < registry->threads_.size(); ++i) {
+                if (registry->threads_[i] == &table) {
+                    registry->threads_.erase(registry->threads_.begin() + i);
+                    break;
+                }
+            }
+        }
+    };
+
+    class Retired {
+    public:
+        Retired() { std::memset(static_cast<void*>(stages_), 0, sizeof(stages_)); }
+
+        void absorb(int stage, const StageLatency& l) {
+            stages_[stage].calls += l.calls;
+            stages_[stage].totalNs += l.totalNs;
+            if (l.maxNs > stages_[stage].maxNs)
+                stages_[stage].maxNs = l.maxNs;
+            stages_[stage].histogram.merge(l.histogram);
+        }
+
+        void addTo(int stage, StageLatency& out) const {
+            out.calls += stages_[stage].calls;
+            out.totalNs += stages_[stage].totalNs;
+            if (stages_[stage].maxNs > out.maxNs)
+                out.maxNs = stages_[stage].maxNs;
+            out.histogram.merge(stages_[stage].histogram);
+        }
+
+    private:
+        StageLatency stages_[kMaxStages];
+    };
+
+    Local& local() {
+        thread_local Local l(this);
+        return l;
+    }
+
+    std::mutex mutex_;
+    std::vector<const char*> names_; // string literals, not copied
+    std::vector<ThreadTable*> threads_;
+    Retired retired_;
+};
+
+// The process-wide registry.
+inline StageRegistry& stageRegistry() {
+    static StageRegistry registry;
+    return registry;
+}
+
+// Records the time from construction to destruction under one stage.
+class ScopedStageTimer {
+public:
+    explicit ScopedStageTimer(int stage) : stage_(stage), start_(stageClockNs()) {}
+    ~ScopedStageTimer() { stageRegistry().record(stage_, stageClockNs() - start_); }
+
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+private:
+    int stage_;
+    unsigned long long start_;
+};
+
+#endif
@@ -0,0 +1,310 @@
+#ifndef IO_RATES_H
+#define IO_RATES_H
+
+// Rate collectors for block devices (/proc/diskstats) and network
+// interfaces (/proc/net/dev). Like the CPU path, each keeps its /proc file
+// open, re-reads it with pread into a fixed buffer, parses it with the
+// integer scanner and turns counter deltas into per-second rates. Device
+// tables are sized when a device is first seen; steady-state sampling does
+// not allocate. Devices that stay gone for a few samples (unplugged disks,
+// veth pairs of exited containers) are dropped, so churn does not grow the
+// tables.
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <vector>
+
+#include "proc_backend.h"
+
+struct DiskRate {
+    char name[32];
+    double readBytes;  // per second
+    double writeBytes; // per second
+    double readOps;    // per second
+    double writeOps;   // per second
+    double awaitMs;    // average time per completed I/O
+    double util;       // percent of the interval with I/O in flight
+    double queueDepth; // average number of I/Os in flight
+};
+
+struct NetRate {
+    char name[32];
+    double rxBytes;   // per second
+    double txBytes;   // per second
+    double rxPackets; // per second
+    double txPackets; // per second
+};
+
+// CLOCK_MONOTONIC, or the capture's clock while replaying one.
+inline long long monotonicNs() {
+    ProcTap* tap = procTap();
+    if (tap && tap->replaying())
+        return tap->clockNs();
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<long long>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// Samples a device may be missing before its row is dropped; a device
+// that returns after that starts over as new.
+const unsigned kMaxAbsentSamples = 5;
+
+// Rows of N cumulative counters keyed by device name, with the previous
+// sample kept alongside for deltas.
+template <int N>
+class CounterTable {
+public:
+    struct Row {
+        char name[32];
+        unsigned long long prev[N];
+        unsigned long long cur[N];
+        bool present;
+        bool primed;
+        unsigned absent; // consecutive samples without the device
+    };
+
+    std::vector<Row> rows;
+
+    void beginSample() {
+        for (size_t i = 0; i < rows.size(); ++i)
+            rows[i].present = false;
+        hint_ = 0;
+    }
+
+    // Rows usually come back in the same order, so the search starts where
+    // the previous match left off.
+    Row& row(const char* name, size_t len) {
+        if (len >= sizeof(rows[0].name))
+            len = sizeof(rows[0].name) - 1;
+        for (size_t k = 0; k < rows.size(); ++k) {
+            size_t i = (hint_ + k) % rows.size();
+            if (std::strncmp(rows[i].name, name, len) == 0 && rows[i].name[len] == '\0') {
+                hint_ = i + 1;
+                return rows[i];
+            }
+        }
+        Row r;
+        std::memset(&r, 0, sizeof(r));
+        std::memcpy(r.name, name, len);
+        rows.push_back(r);
+        hint_ = rows.size();
+        return rows.back();
+    }
+
+    // Rotates cur into prev. Rows seen for the first time, or again after
+    // disappearing (their counters may have restarted), only become
+    // eligible for rates on the next sample. Rows absent for more than
+    // kMaxAbsentSamples are removed; the rest keep their order.
+    void endSample() {
+        size_t kept = 0;
+        for (size_t i = 0; i < rows.size(); ++i) {
+            Row& r = rows[i];
+            if (r.present) {
+                std::memcpy(r.prev, r.cur, sizeof(r.cur));
+                r.primed = true;
+                r.absent = 0;
+            } else {
+                r.primed = false;
+                if (++r.absent > kMaxAbsentSamples)
+                    continue;
+            }
+            if (kept != i)
+                rows[kept] = r;
+            ++kept;
+        }
+        rows.resize(kept);
+    }
+
+private:
+    size_t hint_ = 0;
+};
+
+class DiskStatsSampler {
+public:
+    DiskStatsSampler() : diskstats_(new ProcFile<1 << 16>("/proc/diskstats")), prevNs_(0), samples_(0) {}
+
+    // Fills one entry per whole-disk device that was present in both this
+    // and the previous sample. Partitions, loop and ram devices are skipped.
+    bool sample(std::vector<DiskRate>& out) {
+        if (!diskstats_->read())
+            return false;
+        long long now = monotonicNs();
+        double seconds = prevNs_ ? (now - prevNs_) / 1e9 : 0.0;
+        prevNs_ = now;
+        ++samples_;
+
+        table_.beginSample();
+        for (const char* p = diskstats_->buf; *p; p = nextLine(p)) {
+            unsigned long long major, minor;
+            if (!scanField(p, major) || !scanField(p, minor))
+                continue;
+            while (*p == ' ')
+                ++p;
+            const char* name = p;
+            while (*p && *p != ' ' && *p != '\n')
+                ++p;
+            size_t len = static_cast<size_t>(p - name);
+            if (len == 0 || !wholeDisk(name, len))
+                continue;
+
+            CounterTable<kFields>::Row& r = table_.row(name, len);
+            int n = 0;
+            while (n < kFields && scanField(p, r.cur[n]))
+                ++n;
+            r.present = n == kFields;
+        }
+
+        out.clear();
+        for (size_t i = 0; i < table_.rows.size(); ++i) {
+            const CounterTable<kFields>::Row& r = table_.rows[i];
+            if (!r.present || !r.primed || seconds <= 0)
+                continue;
+            double reads = static_cast<double>(r.cur[READS] - r.prev[READS]);
+            double writes = static_cast<double>(r.cur[WRITES] - r.prev[WRITES]);
+            double waitMs = static_cast<double>((r.cur[READ_MS] - r.prev[READ_MS]) + (r.cur[WRITE_MS] - r.prev[WRITE_MS]));
+            double intervalMs = seconds * 1000.0;
+
+            DiskRate rate;
+            std::memcpy(rate.name, r.name, sizeof(rate.name));
+            rate.readBytes = (r.cur[READ_SECTORS] - r.prev[READ_SECTORS]) * 512.0 / seconds;
+            rate.writeBytes = (r.cur[WRITE_SECTORS] - r.prev[WRITE_SECTORS]) * 512.0 / seconds;
+            rate.readOps = reads / seconds;
+            rate.writeOps = writes / seconds;
+            rate.awaitMs = reads + writes > 0 ? waitMs / (reads + writes) : 0.0;
+            rate.util = (r.cur[IO_MS] - r.prev[IO_MS]) / intervalMs * 100.0;
+            rate.queueDepth = (r.cur[WEIGHTED_MS] - r.prev[WEIGHTED_MS]) / intervalMs;
+            out.push_back(rate);
+        }
+        table_.endSample();
+        pruneKnown();
+        return true;
+    }
+
+private:
+    // The first 11 counters after the device name.
+    enum Field {
+        READS,
+        READS_MERGED,
+        READ_SECTORS,
+        READ_MS,
+        WRITES,
+        WRITES_MERGED,
+        WRITE_SECTORS,
+        WRITE_MS,
+        IN_FLIGHT,
+        IO_MS,
+        WEIGHTED_MS,
+        kFields
+    };
+
+    // Whole disks have a /sys/block entry, partitions do not. Checked once
+    // per name and cached while the name keeps showing up.
+    bool wholeDisk(const char* name, size_t len) {
+        if ((len >= 4 && std::strncmp(name, "loop", 4) == 0) || (len >= 3 && std::strncmp(name, "ram", 3) == 0))
+            return false;
+        for (size_t i = 0; i < known_.size(); ++i) {
+            if (std::strncmp(known_[i].name, name, len) == 0 && known_[i].name[len] == '\0') {
+                known_[i].lastSeen = samples_;
+                return known_[i].whole;
+            }
+        }
+        KnownDevice d;
+        std::memset(&d, 0, sizeof(d));
+        std::memcpy(d.name, name, len < sizeof(d.name) - 1 ? len : sizeof(d.name) - 1);
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/block/%s", d.name);
+        d.whole = procPathExists(path);
+        d.lastSeen = samples_;
+        known_.push_back(d);
+        return d.whole;
+    }
+
+    // Forgets names gone for more than kMaxAbsentSamples, as the counter
+    // table does.
+    void pruneKnown() {
+        size_t kept = 0;
+        for (size_t i = 0; i < known_.size(); ++i) {
+            if (samples_ - known_[i].lastSeen > kMaxAbsentSamples)
+                continue;
+            if (kept != i)
+                known_[kept] = known_[i];
+            ++kept;
+        }
+        known_.resize(kept);
+    }
+
+    struct KnownDevice {
+        char name[32];
+        bool whole;
+        unsigned long long lastSeen; // samples_ when last listed
+    };
+
+    std::unique_ptr<ProcFile<1 << 16>> diskstats_;
+    CounterTable<kFields> table_;
+    std::vector<KnownDevice> known_;
+    long long prevNs_;
+    unsigned long long samples_;
+};
+
+class NetDevSampler {
+public:
+    NetDevSampler() : netdev_(new ProcFile<1 << 16>("/proc/net/dev")), prevNs_(0) {}
+
+    bool sample(std::vector<NetRate>& out) {
+        if (!netdev_->read())
+            return false;
+        long long now = monotonicNs();
+        double seconds = prevNs_ ? (now - prevNs_) / 1e9 : 0.0;
+        prevNs_ = now;
+
+        table_.beginSample();
+        // Two header lines, then "  eth0: rx_bytes rx_packets ... tx_bytes tx_packets ..."
+        const char* p = nextLine(nextLine(netdev_->buf));
+        for (; *p; p = nextLine(p)) {
+            while (*p == ' ')
+                ++p;
+            const char* name = p;
+            while (*p && *p != ':' && *p != '\n')
+                ++p;
+            if (*p != ':')
+                continue;
+            size_t len = static_cast<size_t>(p - name);
+            ++p;
+
+            CounterTable<kFields>::Row& r = table_.row(name, len);
+            int n = 0;
+            while (n < kFields && scanField(p, r.cur[n]))
+                ++n;
+            r.present = n == kFields;
+        }
+
+        out.clear();
+        for (size_t i = 0; i < table_.rows.size(); ++i) {
+            const CounterTable<kFields>::Row& r = table_.rows[i];
+            if (!r.present || !r.primed || seconds <= 0)
+                continue;
+            NetRate rate;
+            std::memcpy(rate.name, r.name, sizeof(rate.name));
+            rate.rxBytes = (r.cur[RX_BYTES] - r.prev[RX_BYTES]) / seconds;
+            rate.txBytes = (r.cur[TX_BYTES] - r.prev[TX_BYTES]) / seconds;
+            rate.rxPackets = (r.cur[RX_PACKETS] - r.prev[RX_PACKETS]) / seconds;
+            rate.txPackets = (r.cur[TX_PACKETS] - r.prev[TX_PACKETS]) / seconds;
+            out.push_back(rate);
+        }
+        table_.endSample();
+        return true;
+    }
+
+private:
+    // The first 10 counters after the interface name: 8 receive, then
+    // transmit bytes and packets.
+    enum Field { RX_BYTES, RX_PACKETS, RX_ERRS, RX_DROP, RX_FIFO, RX_FRAME, RX_COMPRESSED, RX_MULTICAST, TX_BYTES, TX_PACKETS, kFields };
+
+    std::unique_ptr<ProcFile<1 << 16>> netdev_;
+    CounterTable<kFields> table_;
+    long long prevNs_;
+};
+
+#endif
@@ -0,0 +1,302 @@
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+// Minimal HTTP endpoint serving the latest metrics in the Prometheus text
+// format on localhost.
+//
+// The sampler renders the exposition once per tick and publishes it as an
+// immutable, reference-counted response (headers and body, both
+// pre-rendered). The server thread answers every scrape with a gathered
+// write (sendmsg, i.e. writev with MSG_NOSIGNAL) straight from that shared
+// buffer, so concurrent scrapers cost no formatting or copying; a response
+// in flight keeps its buffer alive even if a newer one is published
+// meanwhile. Connections are closed after one response.
+//
+// A connection gets kConnectionTimeoutMs from accept to finish its request
+// and take the response; the server thread wakes at least once a second
+// while any are open and closes those past their deadline. When all
+// kMaxConnections slots are taken, a new connection evicts the oldest one,
+// so clients that open sockets and send nothing cannot lock a scraper out.
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+struct HttpResponse {
+    std::string head;
+    std::string body;
+};
+
+inline std::shared_ptr<const HttpResponse> makeHttpResponse(const char* status, const char* contentType,
+                                                            std::string body) {
+    std::shared_ptr<HttpResponse> r(new HttpResponse);
+    r->head.reserve(160);
+    r->head.append("HTTP/1.1 ").append(status).append("\r\nContent-Type: ").append(contentType);
+    r->head.append("\r\nContent-Length: ").append(std::to_string(body.size()));
+    r->head.append("\r\nConnection: close\r\n\r\n");
+    r->body.swap(body);
+    return r;
+}
+
+class MetricsServer {
+public:
+    MetricsServer() : listenFd_(-1), epfd_(-1), wakeFd_(-1), stopping_(false) {}
+
+    ~MetricsServer() {
+        if (thread_.joinable()) {
+            stopping_.store(true, std::memory_order_release);
+            uint64_t one = 1;
+            ssize_t n = write(wakeFd_, &one, sizeof(one));
+            (void)n;
+            thread_.join();
+        }
+        for (std::unordered_map<int, Connection>::iterator it = connections_.begin(); it != connections_.end(); ++it)
+            close(it->first);
+        if (listenFd_ >= 0)
+            close(listenFd_);
+        if (epfd_ >= 0)
+            close(epfd_);
+        if (wakeFd_ >= 0)
+            close(wakeFd_);
+    }
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    // Listens on 127.0.0.1:port and starts the server thread.
+    bool start(unsigned short port) {
+        notFound_ = makeHttpResponse("404 Not Found", "text/plain", "Not found. Metrics are at /metrics\n");
+        badRequest_ = makeHttpResponse("400 Bad Request", "text/plain", "Bad request\n");
+        publish("");
+
+        listenFd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd_ < 0) {
+            std::cerr << "Error: Unable to create metrics socket." << std::endl;
+            return false;
+        }
+        int on = 1;
+        setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        struct sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(listenFd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            listen(listenFd_, 128) != 0) {
+            std::cerr << "Error: Unable to listen on 127.0.0.1:" << port << "." << std::endl;
+            return false;
+        }
+
+        epfd_ = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (epfd_ < 0 || wakeFd_ < 0 || !watch(listenFd_, EPOLLIN) || !watch(wakeFd_, EPOLLIN)) {
+            std::cerr << "Error: Unable to set up metrics server." << std::endl;
+            return false;
+        }
+        thread_ = std::thread(&MetricsServer::run, this);
+        return true;
+    }
+
+    // Replaces the /metrics response; call once per tick from the sampler.
+    void publish(std::string body) {
+        std::shared_ptr<const HttpResponse> r =
+            makeHttpResponse("200 OK", "text/plain; version=0.0.4; charset=utf-8", std::move(body));
+        std::atomic_store(&metrics_, r);
+    }
+
+private:
+    struct Connection {
+        char request[1024];
+        size_t received;
+        std::shared_ptr<const HttpResponse> response;
+        size_t sent;
+        long long deadlineMs;
+    };
+
+    static long long monotonicMs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<long long>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+    }
+
+    bool watch(int fd, uint32_t events) {
+        struct epoll_event ev;
+        ev.events = events;
+        ev.data.fd = fd;
+        return epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) == 0;
+    }
+
+    void drop(int fd) {
+        connections_.erase(fd);
+        close(fd); // also removes it from the epoll set
+    }
+
+    void run() {
+        struct epoll_event events[64];
+        while (!stopping_.load(std::memory_order_acquire)) {
+            int n = epoll_wait(epfd_, events, 64, connections_.empty() ? -1 : 1000);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                std::cerr << "Error: Metrics server epoll_wait failed." << std::endl;
+                return;
+            }
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == wakeFd_)
+                    continue;
+                if (fd == listenFd_)
+                    acceptAll();
+                else
+                    service(fd);
+            }
+            if (!connections_.empty())
+                expire(monotonicMs());
+        }
+    }
+
+    void acceptAll() {
+        while (true) {
+            int fd = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+                return; // EAGAIN once the backlog is drained
+            if (connections_.size() >= kMaxConnections)
+                dropOldest();
+            if (!watch(fd, EPOLLIN | EPOLLOUT | EPOLLET)) {
+                close(fd);
+                continue;
+            }
+            Connection& c = connections_[fd];
+            c.received = 0;
+            c.sent = 0;
+            c.deadlineMs = monotonicMs() + kConnectionTimeoutMs;
+        }
+    }
+
+    // Closes every connection past its deadline.
+    void expire(long long nowMs) {
+        std::unordered_map<int, Connection>::iterator it = connections_.begin();
+        while (it != connections_.end()) {
+            if (it->second.deadlineMs > nowMs) {
+                ++it;
+                continue;
+            }
+            close(it->first);
+            it = connections_.erase(it);
+        }
+    }
+
+    // Closes the connection accepted first; only runs when every slot is
+    // taken.
+    void dropOldest() {
+        std::unordered_map<int, Connection>::iterator oldest = connections_.begin();
+        for (std::unordered_map<int, Connection>::iterator it = connections_.begin(); it != connections_.end(); ++it) {
+            if (it->second.deadlineMs < oldest->second.deadlineMs)
+                oldest = it;
+        }
+        if (oldest != connections_.end())
+            drop(oldest->first);
+    }
+
+    // Edge-triggered: read until the request head is complete, then write
+    // until done or the socket is full.
+    void service(int fd) {
+        std::unordered_map<int, Connection>::iterator it = connections_.find(fd);
+        if (it == connections_.end())
+            return;
+        Connection& c = it->second;
+        if (!c.response && !receive(fd, c))
+            return;
+        if (c.response)
+            respond(fd, c);
+    }
+
+    // Returns true once a response has been chosen.
+    bool receive(int fd, Connection& c) {
+        while (c.received < sizeof(c.request) - 1) {
+            ssize_t n = read(fd, c.request + c.received, sizeof(c.request) - 1 - c.received);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return false;
+            if (n <= 0) {
+                drop(fd);
+                return false;
+            }
+            c.received += static_cast<size_t>(n);
+            c.request[c.received] = '\0';
+            if (std::strstr(c.request, "\r\n\r\n") || std::strstr(c.request, "\n\n"))
+                break;
+        }
+        c.response = route(c.request);
+        return true;
+    }
+
+    std::shared_ptr<const HttpResponse> route(const char* request) const {
+        if (std::strncmp(request, "GET ", 4) != 0)
+            return badRequest_;
+        const char* path = request + 4;
+        size_t len = std::strcspn(path, " ?\r\n");
+        if ((len == 8 && std::strncmp(path, "/metrics", 8) == 0) || (len == 1 && *path == '/'))
+            return std::atomic_load(&metrics_);
+        return notFound_;
+    }
+
+    void respond(int fd, Connection& c) {
+        const HttpResponse& r = *c.response;
+        size_t total = r.head.size() + r.body.size();
+        while (c.sent < total) {
+            struct iovec iov[2];
+            int parts = 0;
+            if (c.sent < r.head.size()) {
+                iov[parts].iov_base = const_cast<char*>(r.head.data() + c.sent);
+                iov[parts].iov_len = r.head.size() - c.sent;
+                ++parts;
+            }
+            size_t bodyOffset = c.sent > r.head.size() ? c.sent - r.head.size() : 0;
+            if (bodyOffset < r.body.size()) {
+                iov[parts].iov_base = const_cast<char*>(r.body.data() + bodyOffset);
+                iov[parts].iov_len = r.body.size() - bodyOffset;
+                ++parts;
+            }
+            struct msghdr msg;
+            std::memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = static_cast<size_t>(parts);
+            ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return; // wait for EPOLLOUT
+            if (n <= 0)
+                break;
+            c.sent += static_cast<size_t>(n);
+        }
+        drop(fd);
+    }
+
+    static const size_t kMaxConnections = 1024;
+    static const long long kConnectionTimeoutMs = 5000;
+
+    int listenFd_;
+    int epfd_;
+    int wakeFd_;
+    std::atomic<bool> stopping_;
+    std::shared_ptr<const HttpResponse> metrics_; // accessed with atomic_load/atomic_store
+    std::shared_ptr<const HttpResponse> notFound_;
+    std::shared_ptr<const HttpResponse> badRequest_;
+    std::unordered_map<int, Connection> connections_; // server thread only
+    std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,244 @@
+#ifndef MONITOR_CORE_H
+#define MONITOR_CORE_H
+
+// The monitoring core shared by resmonitoring, resourcemon2 and
+// system_usage.
+//
+// A collector is a type with static label() ("CPU", for reports) and key()
+// ("cpu", for option names, task names and metric labels), and a
+// bool sample(double& usage) member. MonitorCore<Collectors...> holds one
+// collector and one MetricState per type, laid out in a tuple; sampling and
+// iteration expand the parameter pack at compile time, so the sample loop
+// is a straight sequence of inlined collector calls with no virtual
+// dispatch. Sinks are plain types with a template write(core) member and
+// are composed the same way by runMonitor(). Adding a metric means writing
+// one collector type and listing it where a program builds its core.
+
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <ostream>
+#include <thread>
+#include <tuple>
+
+#include "alerts.h"
+#include "hdr_histogram.h"
+#include "ring_window.h"
+#include "seqlock.h"
+
+#ifdef _WIN32
+#include "win_backend.h"
+#else
+#include "proc_backend.h"
+#endif
+
+struct UsageStats {
+    double currentUsage;
+    double maxUsage;
+    double totalUsage;
+    int count;
+};
+
+inline void updateResourceStats(UsageStats& stats, double currentUsage) {
+    stats.currentUsage = currentUsage;
+    if (currentUsage > stats.maxUsage)
+        stats.maxUsage = currentUsage;
+    stats.totalUsage += currentUsage;
+    stats.count++;
+}
+
+inline double averageUsage(const UsageStats& stats) {
+    return stats.count ? stats.totalUsage / stats.count : 0.0;
+}
+
+// Everything kept per metric. Only the sampling thread writes it; other
+// threads read the snapshot.
+struct MetricState {
+    std::chrono::milliseconds interval;
+    UsageStats stats;
+    LoadWindows windows;
+    UsagePercentiles percentiles; // fixed-size, so tails need no raw history
+    Seqlock<UsageStats> snapshot;
+    AlertDetector alerts; // sees every sample; events are read by alert sinks
+
+    explicit MetricState(std::chrono::milliseconds sampleInterval)
+        : interval(sampleInterval), stats{0.0, 0.0, 0.0, 0}, windows(sampleInterval) {}
+
+    void record(double usage) {
+        updateResourceStats(stats, usage);
+        alerts.update(usage);
+        percentiles.record(usage);
+        windows.push(usage);
+        snapshot.store(stats);
+    }
+};
+
+struct CpuCollector {
+    static const char* label() { return "CPU"; }
+    static const char* key() { return "cpu"; }
+    bool sample(double& usage) { return getCPUUsage(usage); }
+};
+
+struct RamCollector {
+    static const char* label() { return "RAM"; }
+    static const char* key() { return "ram"; }
+    bool sample(double& usage) { return getRAMUsage(usage); }
+};
+
+struct DiskCollector {
+    static const char* label() { return "Disk"; }
+    static const char* key() { return "disk"; }
+    bool sample(double& usage) { return getDiskUsage(usage); }
+};
+
+// A collector and its state.
+template <typename Collector>
+struct MetricSlot {
+    Collector collector;
+    MetricState state;
+
+    explicit MetricSlot(std::chrono::milliseconds interval) : state(interval) {}
+
+    bool sample() {
+        double usage;
+        if (!collector.sample(usage))
+            return false;
+        state.record(usage);
+        return true;
+    }
+};
+
+// Position of T in Ts... (each collector type may appear once).
+template <typename T, typename... Ts>
+struct TypeIndex;
+
+template <typename T, typename... Ts>
+struct TypeIndex<T, T, Ts...> {
+    static const size_t value = 0;
+};
+
+template <typename T, typename U, typename... Ts>
+struct TypeIndex<T, U, Ts...> {
+    static const size_t value = 1 + TypeIndex<T, Ts...>::value;
+};
+
+template <typename... Collectors>
+class MonitorCore {
+    static_assert(sizeof...(Collectors) > 0, "MonitorCore needs at least one collector");
+
+public:
+    static const size_t kMetrics = sizeof...(Collectors);
+    typedef MetricState State;
+
+    // Same interval for every metric.
+    explicit MonitorCore(std::chrono::milliseconds interval)
+        : slots_(same<Collectors>(interval)...) {}
+
+    // One interval per metric, in collector order.
+    explicit MonitorCore(const std::chrono::milliseconds (&intervals)[sizeof...(Collectors)])
+        : slots_(intervals[TypeIndex<Collectors, Collectors...>::value]...) {}
+
+    MonitorCore(const MonitorCore&) = delete;
+    MonitorCore& operator=(const MonitorCore&) = delete;
+
+    static const char* label(size_t i) {
+        static const char* const labels[] = {Collectors::label()...};
+        return labels[i];
+    }
+
+    static const char* key(size_t i) {
+        static const char* const keys[] = {Collectors::key()...};
+        return keys[i];
+    }
+
+    template <typename C>
+    MetricSlot<C>& slot() {
+        return std::get<TypeIndex<C, Collectors...>::value>(slots_);
+    }
+
+    template <typename C>
+    const MetricState& metric() const {
+        return std::get<TypeIndex<C, Collectors...>::value>(slots_).state;
+    }
+
+    template <typename C>
+    bool sample() {
+        return slot<C>().sample();
+    }
+
+    // Samples every metric once, in collector order.
+    void sampleAll() {
+        int expand[] = {(sample<Collectors>(), 0)...};
+        (void)expand;
+    }
+
+    // Calls f(label, key, state) for every metric, in collector order.
+    template <typename F>
+    void forEach(F f) const {
+        int expand[] = {(f(Collectors::label(), Collectors::key(), metric<Collectors>()), 0)...};
+        (void)expand;
+    }
+
+    // Calls f(slot) with every MetricSlot<C>&, for callers that need the
+    // collector type itself (e.g. to schedule it).
+    template <typename F>
+    void visit(F& f) {
+        int expand[] = {(f(slot<Collectors>()), 0)...};
+        (void)expand;
+    }
+
+private:
+    // Repeats a value once per collector in a pack expansion.
+    template <typename>
+    static std::chrono::milliseconds same(std::chrono::milliseconds value) {
+        return value;
+    }
+
+    std::tuple<MetricSlot<Collectors>...> slots_;
+};
+
+// "Current CPU Usage: ..." / "Max ..." / "Average ..." for every metric,
+// separated by rules: the block all reports start with.
+template <typename Core>
+void writeUsageSummary(std::ostream& out, const Core& core) {
+    bool first = true;
+    core.forEach([&](const char* label, const char*, const MetricState& m) {
+        UsageStats u = m.snapshot.load();
+        if (!first)
+            out << "--------------------------------------" << std::endl;
+        first = false;
+        out << "Current " << label << " Usage: " << u.currentUsage << "%" << std::endl;
+        out << "Max " << label << " Usage: " << u.maxUsage << "%" << std::endl;
+        out << "Average " << label << " Usage: " << averageUsage(u) << "%" << std::endl;
+    });
+}
+
+inline void writeWindows(std::ostream& out, const char* label, const LoadWindows& windows) {
+    const size_t ids[3] = {windows.oneMinute, windows.fiveMinutes, windows.fifteenMinutes};
+    const char* names[3] = {"1m", "5m", "15m"};
+    for (int i = 0; i < 3; ++i) {
+        WindowSummary w = windows.history.summary(ids[i]);
+        out << label << " " << names[i] << ": avg " << w.average << "% min " << w.min << "% max " << w.max << "%"
+            << std::endl;
+    }
+}
+
+inline void writePercentiles(std::ostream& out, const char* label, const UsagePercentiles& percentiles) {
+    out << label << " Percentiles: p50 " << percentiles.percentile(0.50) << "% p95 " << percentiles.percentile(0.95)
+        << "% p99 " << percentiles.percentile(0.99) << "% p99.9 " << percentiles.percentile(0.999) << "%"
+        << std::endl;
+}
+
+// Fixed-rate loop for the simple programs: sample every metric, then hand
+// the core to each sink, until `running` is cleared.
+template <typename Core, typename... Sinks>
+void runMonitor(Core& core, std::chrono::milliseconds interval, const volatile sig_atomic_t& running, Sinks&... sinks) {
+    while (running) {
+        core.sampleAll();
+        int expand[] = {0, (sinks.write(core), 0)...};
+        (void)expand;
+        std::this_thread::sleep_for(interval);
+    }
+}
+
+#endif
@@ -0,0 +1,300 @@
+#ifndef PRIMALITY_H
+#define PRIMALITY_H
+
+// Deterministic primality test for all 64-bit integers.
+//
+// isPrime64(n) divides out the primes up to 53 first, with no division
+// instruction: for odd p, p divides n exactly when n * p^-1 (mod 2^64) is
+// at most (2^64 - 1) / p. That rejects about 80% of random odd inputs for a
+// handful of multiplies. What survives gets a strong probable-prime
+// (Miller-Rabin) test with a base set known to have no 64-bit
+// pseudoprimes: {2, 7, 61} below 2^32 and Jim Sinclair's seven bases above.
+// The modular arithmetic is Montgomery form with R = 2^64, so a modular
+// multiply is three 64x64->128 multiplies and no division; the only
+// divisions are the two needed to set up R mod n and R^2 mod n.
+//
+// isPrimeBatch tests an array. After the small-prime filter, the survivors
+// go through the bases in rounds, kPrimalityLanes candidates at a time.
+// Each lane's exponentiation runs in the same loop as the others'. The
+// lanes do not depend on each other, so their multiplies overlap in the
+// pipeline instead of each waiting on the previous one's latency, which is
+// what bounds a single test.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bit_ops.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+const size_t kPrimalityLanes = 4;
+
+// The lane loops must be unrolled for the lanes to overlap; -O2 does not
+// unroll on its own.
+#if defined(__clang__)
+#define PRIMALITY_UNROLL_LANES _Pragma("unroll")
+#elif defined(__GNUC__) && __GNUC__ >= 8
+#define PRIMALITY_UNROLL_LANES _Pragma("GCC unroll 8")
+#else
+#define PRIMALITY_UNROLL_LANES
+#endif
+
+// High 64 bits of a * b.
+inline uint64_t mulHigh64(uint64_t a, uint64_t b) {
+#ifdef _MSC_VER
+    return __umulh(a, b);
+#else
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) >> 64);
+#endif
+}
+
+// a * b mod n, for a, b < n.
+inline uint64_t mulMod64(uint64_t a, uint64_t b, uint64_t n) {
+#ifdef _MSC_VER
+    uint64_t high;
+    uint64_t low = _umul128(a, b, &high);
+    uint64_t rem;
+    _udiv128(high, low, n, &rem);
+    return rem;
+#else
+    return static_cast<uint64_t>(static_cast<unsigned __int128>(a) * b % n);
+#endif
+}
+
+// a * b / 2^64 mod n for odd n, with inv = n^-1 mod 2^64 and a * b < n * 2^64.
+// The low halves of a * b and m * n cancel exactly, so only the high half of
+// m * n is needed, and the result is already below n after one correction.
+inline uint64_t montgomeryMul(uint64_t a, uint64_t b, uint64_t n, uint64_t inv) {
+    uint64_t high = mulHigh64(a, b);
+    uint64_t t = mulHigh64(a * b * inv, n);
+    return high >= t ? high - t : high - t + n;
+}
+
+// Arithmetic modulo an odd n in Montgomery form (x is stored as xR mod n,
+// R = 2^64). Values are kept fully reduced, so they compare directly.
+struct Montgomery64 {
+    uint64_t n;
+    uint64_t inv; // n^-1 mod 2^64
+    uint64_t one; // R mod n
+    uint64_t r2;  // R^2 mod n
+
+    explicit Montgomery64(uint64_t modulus) : n(modulus) {
+        // Newton's iteration doubles the correct low bits each step; n is
+        // its own inverse mod 8, so five steps reach 64 bits.
+        inv = n;
+        for (int i = 0; i < 5; ++i)
+            inv *= 2 - n * inv;
+        one = (0 - n) % n;
+        r2 = mulMod64(one, one, n);
+    }
+
+    uint64_t mul(uint64_t a, uint64_t b) const { return montgomeryMul(a, b, n, inv); }
+
+    uint64_t to(uint64_t a) const { return mul(a % n, r2); }
+
+    uint64_t minusOne() const { return n - one; }
+};
+
+// Primes 3..53 with the constants for the divisibility test above.
+struct SmallPrimeDivisor {
+    uint64_t p;
+    uint64_t inverse; // p^-1 mod 2^64
+    uint64_t limit;   // (2^64 - 1) / p
+};
+
+inline const std::vector<SmallPrimeDivisor>& smallPrimeDivisors() {
+    static const std::vector<SmallPrimeDivisor> table = [] {
+        const uint64_t primes[] = {3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53};
+        std::vector<SmallPrimeDivisor> t;
+        for (size_t i = 0; i < sizeof(primes) / sizeof(primes[0]); ++i) {
+            SmallPrimeDivisor d = {primes[i], Montgomery64(primes[i]).inv, ~0ULL / primes[i]};
+            t.push_back(d);
+        }
+        return t;
+    }();
+    return table;
+}
+
+enum SmallPrimeVerdict { SMALL_COMPOSITE, SMALL_PRIME, NEEDS_TEST };
+
+// Settles n < 59^2 and anything with a factor up to 53; the rest needs
+// Miller-Rabin.
+inline SmallPrimeVerdict smallPrimeFilter(uint64_t n) {
+    if (n < 64)
+        return (0x28208A20A08A28ACULL >> n) & 1 ? SMALL_PRIME : SMALL_COMPOSITE; // bit p set for primes p < 64
+    if ((n & 1) == 0)
+        return SMALL_COMPOSITE;
+    const std::vector<SmallPrimeDivisor>& divisors = smallPrimeDivisors();
+    for (size_t i = 0; i < divisors.size(); ++i) {
+        if (n * divisors[i].inverse <= divisors[i].limit)
+            return SMALL_COMPOSITE;
+    }
+    return n < 59 * 59 ? SMALL_PRIME : NEEDS_TEST;
+}
+
+// Miller-Rabin bases with no strong pseudoprimes below 2^32 and 2^64.
+const uint64_t kBases32[] = {2, 7, 61};
+const uint64_t kBases64[] = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+
+inline size_t primalityBaseCount(uint64_t n) { return n >> 32 ? 7 : 3; }
+
+inline uint64_t primalityBase(uint64_t n, size_t k) { return n >> 32 ? kBases64[k] : kBases32[k]; }
+
+// Strong probable-prime test of odd n > 3 to base a.
+inline bool strongProbablePrime(const Montgomery64& m, uint64_t a) {
+    uint64_t base = m.to(a);
+    if (base == 0)
+        return true; // a is a multiple of n; the base says nothing
+    int s = trailingZeros64(m.n - 1);
+    uint64_t d = (m.n - 1) >> s;
+    uint64_t x = m.one;
+    for (int bit = 63 - leadingZeros64(d); bit >= 0; --bit) {
+        x = m.mul(x, x);
+        if ((d >> bit) & 1)
+            x = m.mul(x, base);
+    }
+    const uint64_t minusOne = m.minusOne();
+    if (x == m.one || x == minusOne)
+        return true;
+    for (int i = 1; i < s; ++i) {
+        x = m.mul(x, x);
+        if (x == minusOne)
+            return true;
+    }
+    return false;
+}
+
+inline bool isPrime64(uint64_t n) {
+    SmallPrimeVerdict v = smallPrimeFilter(n);
+    if (v != NEEDS_TEST)
+        return v == SMALL_PRIME;
+    Montgomery64 m(n);
+    for (size_t k = 0; k < primalityBaseCount(n); ++k) {
+        if (!strongProbablePrime(m, primalityBase(n, k)))
+            return false;
+    }
+    return true;
+}
+
+// The strong test of up to kPrimalityLanes candidates, each to its own base,
+// with the lanes' exponentiations interleaved. pass[i] is the result for
+// lane i; lanes past `count` are ignored.
+inline void strongProbablePrimeLanes(const Montgomery64* m, const uint64_t* bases, size_t count, bool* pass) {
+    // Lane state lives in local arrays rather than behind pointers so the
+    // compiler can keep it in registers across the unrolled lane loop.
+    uint64_t n[kPrimalityLanes], inv[kPrimalityLanes], one[kPrimalityLanes], minusOne[kPrimalityLanes];
+    uint64_t base[kPrimalityLanes], d[kPrimalityLanes], x[kPrimalityLanes];
+    int s[kPrimalityLanes];
+    int top = 0;
+    for (size_t i = 0; i < kPrimalityLanes; ++i) {
+        // Unused lanes repeat lane 0 so the loops below need no bounds checks.
+        const Montgomery64& mi = m[i < count ? i : 0];
+        n[i] = mi.n;
+        inv[i] = mi.inv;
+        one[i] = mi.one;
+        minusOne[i] = mi.minusOne();
+        base[i] = mi.to(bases[i < count ? i : 0]);
+        s[i] = trailingZeros64(n[i] - 1);
+        d[i] = (n[i] - 1) >> s[i];
+        x[i] = one[i];
+        int bits = 64 - leadingZeros64(d[i]);
+        top = bits > top ? bits : top;
+    }
+
+    // Fixed 4-bit window over the longest exponent: four squarings, then a
+    // multiply by base^digit from a per-lane table whose entry 0 is one, so
+    // every lane does the same work and no branch depends on the data.
+    // Leading zero digits of a shorter exponent square one, which stays one.
+    // That is about 94 multiplies per 64-bit exponent, against 128 for
+    // square-and-always-multiply.
+    uint64_t powers[kPrimalityLanes][16];
+    for (size_t i = 0; i < kPrimalityLanes; ++i) {
+        powers[i][0] = one[i];
+        for (int k = 1; k < 16; ++k)
+            powers[i][k] = montgomeryMul(powers[i][k - 1], base[i], n[i], inv[i]);
+    }
+    for (int shift = (top + 3) / 4 * 4 - 4; shift >= 0; shift -= 4) {
+        for (int sq = 0; sq < 4; ++sq) {
+            PRIMALITY_UNROLL_LANES
+            for (size_t i = 0; i < kPrimalityLanes; ++i)
+                x[i] = montgomeryMul(x[i], x[i], n[i], inv[i]);
+        }
+        PRIMALITY_UNROLL_LANES
+        for (size_t i = 0; i < kPrimalityLanes; ++i)
+            x[i] = montgomeryMul(x[i], powers[i][(d[i] >> shift) & 15], n[i], inv[i]);
+    }
+
+    int maxS = 0;
+    bool done[kPrimalityLanes];
+    for (size_t i = 0; i < kPrimalityLanes; ++i) {
+        done[i] = base[i] == 0 || x[i] == one[i] || x[i] == minusOne[i];
+        pass[i] = done[i];
+        maxS = s[i] > maxS ? s[i] : maxS;
+    }
+    for (int r = 1; r < maxS; ++r) {
+        PRIMALITY_UNROLL_LANES
+        for (size_t i = 0; i < kPrimalityLanes; ++i) {
+            x[i] = montgomeryMul(x[i], x[i], n[i], inv[i]);
+            if (!done[i] && r < s[i] && x[i] == minusOne[i])
+                pass[i] = done[i] = true;
+        }
+    }
+}
+
+// Writes 1 to isPrime[i] if values[i] is prime, else 0, and returns how
+// many were prime. Results are identical to isPrime64.
+inline size_t isPrimeBatch(const uint64_t* values, size_t count, uint8_t* isPrime) {
+    // Indices still in the running; each round keeps those that pass.
+    std::vector<size_t> pending;
+    pending.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        SmallPrimeVerdict v = smallPrimeFilter(values[i]);
+        isPrime[i] = v == SMALL_PRIME;
+        if (v == NEEDS_TEST)
+            pending.push_back(i);
+    }
+
+    std::vector<Montgomery64> moduli;
+    moduli.reserve(pending.size());
+    for (size_t j = 0; j < pending.size(); ++j)
+        moduli.push_back(Montgomery64(values[pending[j]]));
+
+    // Round k tests every candidate still pending with its k-th base.
+    // Candidates below 2^32 run out of bases after round 2 and are prime.
+    for (size_t k = 0; !pending.empty(); ++k) {
+        size_t kept = 0;
+        for (size_t j = 0; j < pending.size(); j += kPrimalityLanes) {
+            size_t lanes = pending.size() - j < kPrimalityLanes ? pending.size() - j : kPrimalityLanes;
+            uint64_t bases[kPrimalityLanes];
+            const Montgomery64* m = &moduli[j];
+            bool pass[kPrimalityLanes];
+            for (size_t i = 0; i < lanes; ++i)
+                bases[i] = primalityBase(m[i].n, k);
+            strongProbablePrimeLanes(m, bases, lanes, pass);
+            for (size_t i = 0; i < lanes; ++i) {
+                if (!pass[i])
+                    continue;
+                if (k + 1 == primalityBaseCount(m[i].n)) {
+                    isPrime[pending[j + i]] = 1;
+                } else {
+                    // kept <= j + i, so this never overwrites a lane not yet read.
+                    pending[kept] = pending[j + i];
+                    moduli[kept] = m[i];
+                    ++kept;
+                }
+            }
+        }
+        pending.resize(kept);
+        moduli.erase(moduli.begin() + kept, moduli.end());
+    }
+
+    size_t primes = 0;
+    for (size_t i = 0; i < count; ++i)
+        primes += isPrime[i];
+    return primes;
+}
+
+#endif
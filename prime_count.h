@@ -0,0 +1,413 @@
+#ifndef PRIME_COUNT_H
+#define PRIME_COUNT_H
+
+// pi(x) in about O(x^(2/3)) time: the Lagarias-Miller-Odlyzko form of the
+// Meissel-Lehmer method.
+//
+// With y a little above x^(1/3) and a = pi(y),
+//
+//   pi(x) = phi(x, a) + a - 1 - P2(x, a)
+//
+// where phi(x, b) counts the integers in [1, x] with no prime factor among
+// the first b primes, and P2 counts the n <= x that are a product of two
+// primes above y. phi(x, a) is expanded with phi(x, b) = phi(x, b - 1) -
+// phi(x / p_b, b - 1) into
+//
+//   S1 = sum over squarefree n <= y with no factor among the first c
+//        primes of mu(n) phi(x / n, c)
+//   S2 = - sum over c < b <= a, squarefree m <= y < m p_b with least
+//        prime factor above p_b, of mu(m) phi(x / (m p_b), b - 1)
+//
+// c is at most 6, so phi(n, c) is a lookup in a table of one period of the
+// first c primes (30030 numbers). S2 is the expensive part: its arguments
+// lie in [1, x / y], which is sieved in segments. A segment starts with
+// the numbers coprime to the first c primes and is sieved by p_{c+1},
+// p_{c+2}, ... in turn. Before sieving by p_b, every leaf of p_b whose
+// argument falls in the segment reads its phi as the count left before the
+// segment plus a prefix count from a Fenwick tree over the segment.
+//
+// The interval is cut into chunks on the work-stealing pool. A chunk
+// counts as if it started at 1, and records per b the count it leaves and
+// the sum of the leaves' mu. Since a leaf's value is linear in the count
+// before it, the missing prefix is added afterwards as sum(mu) times the
+// prefix, with the chunks taken in order. P2 needs pi(x / p) for y < p <=
+// sqrt(x), which is prime counting over [sqrt(x), x / y] with the
+// SegmentedSieve, chunked and fixed up the same way.
+//
+// Memory is O(y) for the m tables, O(sqrt(x)) for the primes up to sqrt(x),
+// a segment per worker, and O(a) per chunk.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "prime_sieve.h"
+#include "work_stealing.h"
+
+struct PrimePiStats {
+    uint64_t y;         // leaf bound, about x^(1/3)
+    uint64_t a;         // pi(y)
+    uint64_t sieved;    // x / y, the length of the interval sieved for S2
+    uint64_t leaves;    // special leaves in S2
+    uint64_t s1;        // contribution of the ordinary leaves
+    int64_t s2;         // contribution of the special leaves
+    uint64_t p2;
+};
+
+// Below this, or when x / y would be too short to be worth chunking, pi(x)
+// is a plain sieve count.
+const uint64_t kPrimePiSieveBelow = 100000000;
+
+// floor(cbrt(n)), exact for all 64-bit n.
+inline uint64_t icbrt64(uint64_t n) {
+    uint64_t r = static_cast<uint64_t>(std::cbrt(static_cast<double>(n)));
+    while (r > 0 && r * r > n / r)
+        --r;
+    while ((r + 1) * (r + 1) <= n / (r + 1))
+        ++r;
+    return r;
+}
+
+// Counts of the unsieved numbers in a segment, with O(log n) prefix sums
+// and removals. Zero-based: node i covers [i & (i + 1), i].
+class SegmentCounter {
+public:
+    void reset(const std::vector<uint8_t>& present, size_t size) {
+        tree_.assign(present.begin(), present.begin() + size);
+        for (size_t i = 0; i < size; ++i) {
+            size_t parent = i | (i + 1);
+            if (parent < size)
+                tree_[parent] += tree_[i];
+        }
+    }
+
+    // Number of present entries in [0, i].
+    uint32_t prefix(size_t i) const {
+        uint32_t sum = 0;
+        for (size_t k = i + 1; k > 0; k &= k - 1)
+            sum += tree_[k - 1];
+        return sum;
+    }
+
+    void remove(size_t i) {
+        for (; i < tree_.size(); i |= i + 1)
+            --tree_[i];
+    }
+
+private:
+    std::vector<uint32_t> tree_;
+};
+
+class PrimePi {
+public:
+    explicit PrimePi(WorkStealingPool& pool) : pool_(pool) {}
+
+    uint64_t count(uint64_t x, PrimePiStats* stats = nullptr) {
+        PrimePiStats st = PrimePiStats();
+        uint64_t result = x < kPrimePiSieveBelow ? sieveCount(x) : lmo(x, st);
+        if (stats)
+            *stats = st;
+        return result;
+    }
+
+private:
+    static const size_t kSegment = 1 << 16;  // numbers per S2 segment
+    static const unsigned kWheelPrimes = 6;   // c: 2, 3, 5, 7, 11, 13
+
+    struct Chunk {
+        uint64_t low, high;
+        int64_t s2;                 // leaves with the count before the chunk taken as 0
+        std::vector<int64_t> phi;   // per b: numbers left in the chunk before sieving by p_b
+        std::vector<int64_t> muSum; // per b: sum of -mu(m) over the chunk's leaves of p_b
+        uint64_t leaves;
+    };
+
+    struct P2Chunk {
+        uint64_t low, high;
+        uint64_t primes;  // primes in [low, high)
+        uint64_t local;   // sum over the chunk's queries of primes in [low, x / p]
+        uint64_t queries;
+    };
+
+    uint64_t sieveCount(uint64_t x) {
+        std::vector<uint32_t> base = sieveBasePrimes(isqrt64(x));
+        SegmentedSieve sieve(base);
+        return sieve.count(0, x + 1);
+    }
+
+    uint64_t lmo(uint64_t x, PrimePiStats& st) {
+        x_ = x;
+        sqrtx_ = isqrt64(x);
+        // y = alpha x^(1/3): a larger alpha shortens the interval sieved for S2
+        // at the cost of more leaves. This alpha grows slowly with x and
+        // balances the two for x from 1e9 to 1e15.
+        uint64_t cbrt = icbrt64(x);
+        double alpha = std::max(1.0, std::log(static_cast<double>(x)) / std::log(10.0) - 8.0);
+        y_ = std::min<uint64_t>(sqrtx_, static_cast<uint64_t>(alpha * cbrt));
+
+        // primes_[b] is the b-th prime, 1-based, up to sqrt(x).
+        std::vector<uint32_t> odd = sieveBasePrimes(sqrtx_);
+        primes_.assign(1, 0);
+        primes_.push_back(2);
+        primes_.insert(primes_.end(), odd.begin(), odd.end());
+        a_ = static_cast<size_t>(std::upper_bound(primes_.begin() + 1, primes_.end(), y_) - primes_.begin() - 1);
+        c_ = std::min<size_t>(kWheelPrimes, a_);
+        buildTables();
+
+        st.y = y_;
+        st.a = a_;
+        st.sieved = x_ / y_;
+        st.s1 = ordinaryLeaves();
+        st.s2 = specialLeaves(st.leaves);
+        st.p2 = p2(odd);
+        return static_cast<uint64_t>(static_cast<int64_t>(st.s1) + st.s2) + a_ - 1 - st.p2;
+    }
+
+    // mu and least prime factor for m <= y, pi(m) for m <= y, and the phi
+    // table for the first c primes.
+    void buildTables() {
+        size_t y = static_cast<size_t>(y_);
+        mu_.assign(y + 1, 1);
+        lpf_.assign(y + 1, UINT32_MAX);
+        piY_.assign(y + 1, 0);
+        for (size_t b = a_; b >= 1; --b) {
+            uint32_t p = primes_[b];
+            for (size_t m = p; m <= y; m += p) {
+                mu_[m] = static_cast<int8_t>(-mu_[m]);
+                lpf_[m] = p; // smaller primes come later and overwrite
+            }
+            uint64_t square = static_cast<uint64_t>(p) * p;
+            for (uint64_t m = square; m <= y; m += square)
+                mu_[m] = 0;
+        }
+        for (size_t m = 2, b = 0; m <= y; ++m) {
+            if (b + 1 <= a_ && primes_[b + 1] == m)
+                ++b;
+            piY_[m] = static_cast<uint32_t>(b);
+        }
+
+        wheel_ = 1;
+        for (size_t b = 1; b <= c_; ++b)
+            wheel_ *= primes_[b];
+        coprime_.assign(wheel_, 1);
+        for (size_t b = 1; b <= c_; ++b) {
+            for (size_t r = 0; r < wheel_; r += primes_[b])
+                coprime_[r] = 0;
+        }
+        phiWheel_.assign(wheel_ + 1, 0);
+        for (size_t r = 1; r <= wheel_; ++r)
+            phiWheel_[r] = phiWheel_[r - 1] + coprime_[r % wheel_];
+    }
+
+    // phi(n, c).
+    uint64_t phiC(uint64_t n) const { return n / wheel_ * phiWheel_[wheel_] + phiWheel_[n % wheel_]; }
+
+    uint64_t ordinaryLeaves() const {
+        int64_t s1 = 0;
+        uint32_t pc = primes_[c_];
+        for (size_t n = 1; n <= y_; ++n) {
+            if (mu_[n] != 0 && lpf_[n] > pc)
+                s1 += mu_[n] * static_cast<int64_t>(phiC(x_ / n));
+        }
+        return static_cast<uint64_t>(s1);
+    }
+
+    int64_t specialLeaves(uint64_t& leaves) {
+        const uint64_t end = x_ / y_ + 1; // leaves' arguments are below x / y
+        const uint64_t segments = (end - 1 + kSegment - 1) / kSegment;
+        const uint64_t chunkCount = std::max<uint64_t>(1, std::min<uint64_t>(segments, pool_.size() * 8ULL));
+        const uint64_t segmentsPerChunk = (segments + chunkCount - 1) / chunkCount;
+        std::vector<Chunk> chunks;
+        for (uint64_t low = 1; low < end; low += segmentsPerChunk * kSegment) {
+            Chunk ch = Chunk();
+            ch.low = low;
+            ch.high = std::min<uint64_t>(end, low + segmentsPerChunk * kSegment);
+            chunks.push_back(ch);
+        }
+
+        pool_.run(chunks.size(), [&](unsigned, uint64_t k) { specialLeavesChunk(chunks[k]); });
+
+        int64_t s2 = 0;
+        leaves = 0;
+        std::vector<int64_t> before(a_ + 1, 0);
+        for (size_t k = 0; k < chunks.size(); ++k) {
+            const Chunk& ch = chunks[k];
+            s2 += ch.s2;
+            leaves += ch.leaves;
+            for (size_t b = c_ + 1; b <= a_; ++b) {
+                s2 += ch.muSum[b] * before[b];
+                before[b] += ch.phi[b];
+            }
+        }
+        return s2;
+    }
+
+    void specialLeavesChunk(Chunk& ch) {
+        const size_t a = a_;
+        const uint64_t x = x_;
+        ch.phi.assign(a + 1, 0);
+        ch.muSum.assign(a + 1, 0);
+
+        // Per b: the next odd multiple of p_b to sieve (evens never survive
+        // the wheel), and the leaf candidate to look at next, as a value of
+        // m (p_b^2 <= y, any m) or an index into primes_ (p_b^2 > y, where
+        // m can only be a prime above p_b).
+        std::vector<uint64_t> next(a + 1), leafN(a + 1);
+        std::vector<uint64_t> cursor(a + 1);
+        for (size_t b = c_ + 1; b <= a; ++b) {
+            uint64_t p = primes_[b];
+            uint64_t m = (ch.low + p - 1) / p * p;
+            next[b] = m & 1 ? m : m + p;
+            uint64_t top = std::min<uint64_t>(y_, x / (p * ch.low));
+            cursor[b] = p * p <= y_ ? top : piY_[top];
+            leafN[b] = nextLeaf(b, cursor[b]);
+        }
+
+        std::vector<uint8_t> present(kSegment);
+        SegmentCounter counter;
+        for (uint64_t low = ch.low; low < ch.high; low += kSegment) {
+            uint64_t high = std::min<uint64_t>(ch.high, low + kSegment);
+            size_t size = static_cast<size_t>(high - low);
+            size_t r = static_cast<size_t>(low % wheel_);
+            uint64_t left = 0;
+            for (size_t i = 0; i < size; ++i) {
+                present[i] = coprime_[r];
+                left += present[i];
+                if (++r == wheel_)
+                    r = 0;
+            }
+            counter.reset(present, size);
+
+            for (size_t b = c_ + 1; b <= a; ++b) {
+                uint64_t p = primes_[b];
+                while (leafN[b] < high) {
+                    uint64_t n = leafN[b];
+                    uint64_t m = p * p <= y_ ? cursor[b] : primes_[cursor[b]];
+                    int64_t phi = ch.phi[b] + counter.prefix(static_cast<size_t>(n - low));
+                    ch.s2 -= mu_[m] * phi;
+                    ch.muSum[b] -= mu_[m];
+                    ++ch.leaves;
+                    --cursor[b];
+                    leafN[b] = nextLeaf(b, cursor[b]);
+                }
+                ch.phi[b] += static_cast<int64_t>(left);
+                if (b == a)
+                    break;
+                uint64_t j = next[b];
+                for (; j < high; j += 2 * p) {
+                    size_t i = static_cast<size_t>(j - low);
+                    if (present[i]) {
+                        present[i] = 0;
+                        counter.remove(i);
+                        --left;
+                    }
+                }
+                next[b] = j;
+            }
+        }
+    }
+
+    // x / (m p_b) for the first valid leaf at or below cursor, moving the
+    // cursor onto it; UINT64_MAX when p_b has no leaves left.
+    uint64_t nextLeaf(size_t b, uint64_t& cursor) const {
+        uint64_t p = primes_[b];
+        if (p * p <= y_) {
+            uint64_t low = y_ / p; // m must exceed y / p
+            for (; cursor > low; --cursor) {
+                if (mu_[cursor] != 0 && lpf_[cursor] > p)
+                    return x_ / (cursor * p);
+            }
+            return UINT64_MAX;
+        }
+        return cursor > b ? x_ / (primes_[cursor] * p) : UINT64_MAX;
+    }
+
+    // P2(x, a) = sum over y < p <= sqrt(x) of pi(x / p) - pi(p) + 1.
+    uint64_t p2(const std::vector<uint32_t>& oddPrimes) {
+        size_t last = primes_.size() - 1; // pi(sqrt(x))
+        if (a_ >= last)
+            return 0;
+        // x / p lies in [sqrt(x), x / p_{a+1}]; pi of the values below that is
+        // pi(sqrt(x) - 1).
+        const uint64_t start = sqrtx_;
+        const uint64_t end = x_ / primes_[a_ + 1] + 1;
+        uint64_t below = static_cast<uint64_t>(std::lower_bound(primes_.begin() + 1, primes_.end(), start) -
+                                                     primes_.begin() - 1);
+        const uint64_t chunkCount = std::max<uint64_t>(1, std::min<uint64_t>((end - start) >> 20, pool_.size() * 8ULL));
+        std::vector<P2Chunk> chunks(chunkCount);
+        for (uint64_t k = 0; k < chunkCount; ++k) {
+            chunks[k] = P2Chunk();
+            chunks[k].low = start + (end - start) * k / chunkCount;
+            chunks[k].high = start + (end - start) * (k + 1) / chunkCount;
+        }
+
+        std::vector<std::unique_ptr<SegmentedSieve>> sieves(pool_.size());
+        pool_.run(chunks.size(), [&](unsigned w, uint64_t k) {
+            if (!sieves[w])
+                sieves[w].reset(new SegmentedSieve(oddPrimes));
+            p2Chunk(*sieves[w], chunks[k]);
+        });
+
+        uint64_t total = 0;
+        for (size_t k = 0; k < chunks.size(); ++k) {
+            total += chunks[k].local + chunks[k].queries * below;
+            below += chunks[k].primes;
+        }
+        for (size_t b = a_ + 1; b <= last; ++b)
+            total -= b - 1;
+        return total;
+    }
+
+    void p2Chunk(SegmentedSieve& sieve, P2Chunk& ch) {
+        // The primes p with x / p in [low, high), largest first so that x / p
+        // ascends.
+        std::vector<uint64_t> queries;
+        for (size_t b = primes_.size() - 1; b > a_; --b) {
+            uint64_t v = x_ / primes_[b];
+            if (v >= ch.high)
+                break;
+            if (v >= ch.low)
+                queries.push_back(v);
+        }
+        size_t q = 0;
+        uint64_t running = ch.low <= 2 && 2 < ch.high ? 1 : 0;
+        sieve.sieve(ch.low, ch.high, [&](uint64_t segLow, const uint64_t* composite, size_t bits) {
+            for (; q < queries.size() && queries[q] < segLow + 2 * bits; ++q) {
+                if (queries[q] < segLow) {
+                    ch.local += running;
+                    continue;
+                }
+                size_t last = static_cast<size_t>((queries[q] - segLow) / 2); // bits 0..last are <= x / p
+                uint64_t marked = 0;
+                for (size_t w = 0; w < last / 64; ++w)
+                    marked += static_cast<uint64_t>(popcount64(composite[w]));
+                uint64_t tail = composite[last / 64] & (~0ULL >> (63 - last % 64));
+                marked += static_cast<uint64_t>(popcount64(tail));
+                ch.local += running + last + 1 - marked;
+            }
+            uint64_t marked = 0;
+            for (size_t w = 0; w < (bits + 63) / 64; ++w)
+                marked += static_cast<uint64_t>(popcount64(composite[w]));
+            running += bits - marked;
+        });
+        for (; q < queries.size(); ++q)
+            ch.local += running;
+        ch.primes = running;
+        ch.queries = queries.size();
+    }
+
+    WorkStealingPool& pool_;
+    uint64_t x_, sqrtx_, y_;
+    size_t a_, c_;
+    std::vector<uint32_t> primes_;
+    std::vector<int8_t> mu_;
+    std::vector<uint32_t> lpf_; // UINT32_MAX for 1
+    std::vector<uint32_t> piY_;
+    size_t wheel_;
+    std::vector<uint8_t> coprime_;    // per residue mod the wheel: 1 if coprime to the first c primes
+    std::vector<uint64_t> phiWheel_;  // phiWheel_[r] = phi(r, c) for r <= wheel
+};
+
+#endif
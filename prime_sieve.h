@@ -0,0 +1,244 @@
+#ifndef PRIME_SIEVE_H
+#define PRIME_SIEVE_H
+
+// Segmented Sieve of Eratosthenes for PRIME_CHECK.
+//
+// The base primes (odd primes up to sqrt(limit)) are computed once with a
+// plain sieve and shared read-only by every segment sieve. A SegmentedSieve
+// walks [start, end) in segments that fit in the L1 data cache. Each
+// segment is a bitmap of odd numbers only (bit i is segLow + 2i), so one
+// byte covers 16 integers. Composites are crossed off starting at p*p,
+// and each prime's next multiple is carried over to the next segment
+// instead of being recomputed with a division. Multiples of 3, 5, 7 and
+// 11 are not crossed off one by one: their combined pattern repeats every
+// 1155 odd numbers and is copied into each segment a word at a time
+// (Presieve).
+// Survivors are counted with a 64-bit popcount per word. Counts are 64-bit
+// throughout.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <unistd.h>
+
+#include "bit_ops.h"
+
+// floor(sqrt(n)), exact for all 64-bit n.
+inline uint64_t isqrt64(uint64_t n) {
+    uint64_t r = static_cast<uint64_t>(std::sqrt(static_cast<double>(n)));
+    while (r > 0 && r > n / r)
+        --r;
+    while ((r + 1) <= n / (r + 1))
+        ++r;
+    return r;
+}
+
+// Odd primes <= limit, by a plain odd-only sieve.
+inline std::vector<uint32_t> sieveSmallPrimes(uint64_t limit) {
+    std::vector<uint32_t> primes;
+    if (limit < 3)
+        return primes;
+    // composite[i] is 2i + 1.
+    std::vector<bool> composite(static_cast<size_t>(limit / 2 + 1), false);
+    for (uint64_t i = 1; i < composite.size(); ++i) {
+        if (composite[i])
+            continue;
+        uint64_t p = 2 * i + 1;
+        if (p > limit)
+            break;
+        primes.push_back(static_cast<uint32_t>(p));
+        for (uint64_t j = p * p / 2; j < composite.size(); j += p)
+            composite[j] = true;
+    }
+    return primes;
+}
+
+// L1 data cache size where the platform reports it, else 32 KB.
+inline size_t sieveSegmentBytes() {
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+    long bytes = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+    if (bytes >= 4096)
+        return static_cast<size_t>(bytes);
+#endif
+    return 32768;
+}
+
+// Multiples of 3, 5, 7 and 11 in the odd-only layout. Their combined
+// pattern repeats every 1155 odd numbers, so 64 periods of it repeat on a
+// word boundary; fill() copies it into a segment a word at a time instead
+// of crossing those primes off one by one.
+class Presieve {
+public:
+    static const uint32_t kLargestPrime = 11;
+
+    Presieve() : pattern_(kPeriod + 1, 0) {
+        for (uint64_t j = 0; j < 64 * kPeriod; ++j) {
+            uint64_t n = 2 * j + 1;
+            if (n % 3 == 0 || n % 5 == 0 || n % 7 == 0 || n % 11 == 0)
+                pattern_[j >> 6] |= 1ULL << (j & 63);
+        }
+        pattern_[kPeriod] = pattern_[0];
+    }
+
+    // Fills the first `bits` bits of words (bit i is segLow + 2i, segLow odd)
+    // with the multiples of 3, 5, 7 and 11, except those primes themselves,
+    // and clears the rest of the last word.
+    void fill(uint64_t* words, uint64_t segLow, size_t bits) const {
+        uint64_t j = (segLow - 1) / 2 % (64 * kPeriod); // pattern bit of segLow
+        size_t q = static_cast<size_t>(j >> 6);
+        unsigned r = static_cast<unsigned>(j & 63);
+        size_t n = (bits + 63) / 64;
+        for (size_t w = 0; w < n; ++w) {
+            words[w] = r ? (pattern_[q] >> r) | (pattern_[q + 1] << (64 - r)) : pattern_[q];
+            if (++q == kPeriod)
+                q = 0;
+        }
+        if (bits & 63)
+            words[n - 1] &= (1ULL << (bits & 63)) - 1;
+        if (segLow <= kLargestPrime) {
+            const uint64_t presieved[4] = {3, 5, 7, 11};
+            for (int k = 0; k < 4; ++k) {
+                uint64_t i = (presieved[k] - segLow) / 2;
+                if (presieved[k] >= segLow && i < bits)
+                    words[i >> 6] &= ~(1ULL << (i & 63));
+            }
+        }
+    }
+
+private:
+    static const uint64_t kPeriod = 3 * 5 * 7 * 11; // in odd numbers, and in words of the pattern
+
+    std::vector<uint64_t> pattern_;
+};
+
+class SegmentedSieve {
+public:
+    // basePrimes must cover sqrt(end) for every range sieved and must
+    // outlive the sieve. segmentBytes is rounded down to whole words.
+    explicit SegmentedSieve(const std::vector<uint32_t>& basePrimes, size_t segmentBytes = sieveSegmentBytes())
+        : primes_(basePrimes), words_(std::max<size_t>(segmentBytes / 8, 1)), firstSieved_(0), segLow_(0), end_(0),
+          active_(0), done_(true) {
+        bits_.resize(words_);
+        next_.reserve(primes_.size());
+        while (firstSieved_ < primes_.size() && primes_[firstSieved_] <= Presieve::kLargestPrime)
+            ++firstSieved_;
+    }
+
+    // Number of primes in [start, end).
+    uint64_t count(uint64_t start, uint64_t end) {
+        uint64_t total = start <= 2 && 2 < end ? 1 : 0;
+        sieve(start, end, [&](uint64_t, const uint64_t* composite, size_t bits) {
+            uint64_t marked = 0;
+            for (size_t w = 0; w < (bits + 63) / 64; ++w)
+                marked += static_cast<uint64_t>(popcount64(composite[w]));
+            total += bits - marked;
+        });
+        return total;
+    }
+
+    // Sieves the odd numbers of [start, end) one segment at a time and calls
+    // f(segLow, composite, bits) for each: bit i of composite is set when
+    // segLow + 2i is composite, for i < bits. Bits past `bits` are clear.
+    template <typename F>
+    void sieve(uint64_t start, uint64_t end, F f) {
+        begin(start, end);
+        uint64_t segLow;
+        const uint64_t* composite;
+        size_t bits;
+        while (next(segLow, composite, bits))
+            f(segLow, composite, bits);
+    }
+
+    // The same one segment per call: begin(), then next() until it returns
+    // false. composite stays valid until the following call.
+    void begin(uint64_t start, uint64_t end) {
+        segLow_ = std::max<uint64_t>(start, 3) | 1; // first odd >= start, skipping 1
+        end_ = end;
+        done_ = segLow_ >= end;
+        next_.clear();
+        active_ = 0;
+    }
+
+    bool next(uint64_t& segLow, const uint64_t*& composite, size_t& bits) {
+        if (done_)
+            return false;
+        const uint64_t span = static_cast<uint64_t>(words_) * 64 * 2; // integers per segment
+        uint64_t segHigh = end_ - segLow_ > span ? segLow_ + span : end_;
+        bits = static_cast<size_t>((segHigh - segLow_ + 1) / 2);
+        presieve_.fill(&bits_[0], segLow_, bits);
+
+        // Primes whose square falls below segHigh join as the range grows.
+        while (active_ < primes_.size()) {
+            uint64_t p = primes_[active_];
+            if (p * p >= segHigh)
+                break;
+            // Offset from segLow_ to the first odd multiple >= max(p^2, segLow_),
+            // taken from segLow_ % p so nothing is formed past 2^64.
+            uint64_t offset;
+            if (p * p >= segLow_) {
+                offset = p * p - segLow_;
+            } else {
+                uint64_t r = segLow_ % p;
+                offset = r ? p - r : 0;
+                if (offset & 1)
+                    offset += p;
+            }
+            next_.push_back(offset / 2);
+            ++active_;
+        }
+
+        uint64_t* words = &bits_[0];
+        for (size_t k = firstSieved_; k < active_; ++k) {
+            uint64_t p = primes_[k];
+            uint64_t i = next_[k];
+            for (; i < bits; i += p)
+                words[i >> 6] |= 1ULL << (i & 63);
+            next_[k] = i - bits;
+        }
+        segLow = segLow_;
+        composite = words;
+        done_ = segHigh == end_;
+        segLow_ = segHigh;
+        return true;
+    }
+
+private:
+    const std::vector<uint32_t>& primes_;
+    size_t words_;
+    std::vector<uint64_t> bits_;
+    std::vector<uint64_t> next_; // per active prime: bit index of its next multiple in the next segment
+    Presieve presieve_;
+    size_t firstSieved_; // index of the first base prime above 11
+    uint64_t segLow_;    // first number of the next segment (odd)
+    uint64_t end_;
+    size_t active_;
+    bool done_;
+};
+
+// Odd primes <= limit, for use as base primes. limit is sqrt of the
+// sieving range, so it is below 2^32; the primes up to sqrt(limit) come from
+// a plain sieve and the rest from a SegmentedSieve over them, which keeps
+// the working set in L1 instead of a 2^31-bit table.
+inline std::vector<uint32_t> sieveBasePrimes(uint64_t limit) {
+    const uint64_t small = std::max<uint64_t>(isqrt64(limit), 1024);
+    std::vector<uint32_t> primes = sieveSmallPrimes(std::min(small, limit));
+    if (limit <= small)
+        return primes;
+    primes.reserve(static_cast<size_t>(limit / (std::log(static_cast<double>(limit)) - 1.1)) + 1024);
+    const std::vector<uint32_t> base = primes;
+    SegmentedSieve sieve(base);
+    sieve.sieve(small + 1, limit + 1, [&](uint64_t segLow, const uint64_t* composite, size_t bits) {
+        for (size_t w = 0; w < (bits + 63) / 64; ++w) {
+            uint64_t live = ~composite[w];
+            if (w == bits / 64)
+                live &= (1ULL << (bits & 63)) - 1;
+            for (; live; live &= live - 1)
+                primes.push_back(static_cast<uint32_t>(segLow + 2 * (64 * w + trailingZeros64(live))));
+        }
+    });
+    return primes;
+}
+
+#endif
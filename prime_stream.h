@@ -0,0 +1,391 @@
+#ifndef PRIME_STREAM_H
+#define PRIME_STREAM_H
+
+// Streaming prime enumeration over arbitrary 64-bit ranges.
+//
+// PrimeStream hands out the primes of [start, end) in increasing order, one
+// sieve segment's worth at a time, through nextBatch() or one by one
+// through next(). forEachPrime() is the callback form. Memory does not
+// depend on the width of the range:
+//
+// - The sieving primes (up to sqrt(end)) are produced incrementally by a
+//   BasePrimeSource, itself a SegmentedSieve, and a prime is taken only
+//   once the segment being sieved reaches its square. There is never a
+//   table of all primes up to sqrt(end), which is 2^32 near 2^64.
+// - Primes smaller than a segment carry their next offset from segment to
+//   segment, as in SegmentedSieve.
+// - Larger primes hit a segment at most once, so scanning them all for
+//   every segment would cost pi(sqrt(end)) per segment. They are kept in
+//   buckets instead (a bucket sieve): each prime sits in the bucket of the
+//   segment holding its next odd multiple and is moved on when that segment
+//   is sieved. A prime whose next multiple is past `end` is dropped. The
+//   buckets are lists of fixed-size blocks recycled through a free list, so
+//   memory is about 8 bytes per prime that still has a multiple ahead in
+//   the range, plus one block per bucket. That is at most pi(sqrt(end)): 50
+//   million primes, 400 MB, for a window at 1e18. Ranges narrower than
+//   sqrt(end) need less, because primes with no multiple in the range are
+//   never stored.
+//
+// PrimeRangeStats accumulates count, sum (128-bit), twin primes and gap
+// statistics from batches, and merges across adjacent ranges, so
+// primeRangeStats() can split a range over the work-stealing pool and
+// combine the pieces in order.
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "prime_sieve.h"
+#include "work_stealing.h"
+
+// Odd primes from 13 up to a limit, in increasing order, produced one
+// segment at a time. limit must be below 2^32.
+class BasePrimeSource {
+public:
+    explicit BasePrimeSource(uint64_t limit) : small_(sieveBasePrimes(isqrt64(limit))), sieve_(small_), pos_(0) {
+        sieve_.begin(Presieve::kLargestPrime + 2, limit + 1);
+    }
+
+    // The next prime without consuming it, or 0 past the limit.
+    uint64_t peek() {
+        while (pos_ == primes_.size()) {
+            uint64_t segLow;
+            const uint64_t* composite;
+            size_t bits;
+            if (!sieve_.next(segLow, composite, bits))
+                return 0;
+            primes_.clear();
+            pos_ = 0;
+            for (size_t w = 0; w < (bits + 63) / 64; ++w) {
+                uint64_t live = ~composite[w];
+                if ((w + 1) * 64 > bits)
+                    live &= (1ULL << (bits & 63)) - 1;
+                for (; live; live &= live - 1)
+                    primes_.push_back(static_cast<uint32_t>(segLow + 2 * (w * 64 + trailingZeros64(live))));
+            }
+        }
+        return primes_[pos_];
+    }
+
+    void pop() { ++pos_; }
+
+private:
+    std::vector<uint32_t> small_; // primes up to sqrt(limit), for sieve_
+    SegmentedSieve sieve_;
+    std::vector<uint32_t> primes_; // the current segment's primes
+    size_t pos_;
+};
+
+class PrimeStream {
+public:
+    // The primes p with start <= p < end. segmentBytes is rounded down to a
+    // power of two.
+    PrimeStream(uint64_t start, uint64_t end, size_t segmentBytes = sieveSegmentBytes())
+        : end_(end), first_(std::max<uint64_t>(start, 3) | 1), segment_(0), segments_(0), two_(start <= 2 && 2 < end),
+          source_(end > 1 ? isqrt64(end - 1) : 0), freeBlocks_(nullptr), pos_(0) {
+        shift_ = 6;
+        while ((static_cast<size_t>(1) << (shift_ + 1)) <= segmentBytes * 8 && shift_ < 30)
+            ++shift_;
+        words_.resize((static_cast<size_t>(1) << shift_) / 64);
+        if (first_ < end_) {
+            uint64_t bits = (end_ - first_ + 1) / 2;
+            segments_ = (bits + (1ULL << shift_) - 1) >> shift_;
+        }
+        // A bucket prime is at most sqrt(end) / 2^shift segments ahead, plus one.
+        uint64_t maxPrime = end > 1 ? isqrt64(end - 1) : 0;
+        buckets_.assign(static_cast<size_t>((maxPrime >> shift_) + 2), nullptr);
+        batch_.reserve(static_cast<size_t>(1) << shift_);
+    }
+
+    PrimeStream(const PrimeStream&) = delete;
+    PrimeStream& operator=(const PrimeStream&) = delete;
+
+    // The next batch of primes, ascending; false once the range is done.
+    // The batch stays valid until the following call.
+    bool nextBatch(const uint64_t*& primes, size_t& count) {
+        batch_.clear();
+        pos_ = 0;
+        if (two_) {
+            batch_.push_back(2);
+            two_ = false;
+        }
+        while (batch_.empty() && segment_ < segments_)
+            sieveSegment();
+        primes = batch_.empty() ? nullptr : &batch_[0];
+        count = batch_.size();
+        return count > 0;
+    }
+
+    // The next prime, or 0 once the range is done.
+    uint64_t next() {
+        if (pos_ == batch_.size()) {
+            const uint64_t* primes;
+            size_t count;
+            if (!nextBatch(primes, count))
+                return 0;
+        }
+        return batch_[pos_++];
+    }
+
+private:
+    struct BucketEntry {
+        uint32_t prime;
+        uint32_t bit; // offset of the next odd multiple in its segment
+    };
+
+    static const size_t kBlockEntries = 256;
+
+    struct BucketBlock {
+        BucketEntry entries[kBlockEntries];
+        size_t count;
+        BucketBlock* next;
+    };
+
+    void sieveSegment() {
+        const uint64_t segBits = 1ULL << shift_;
+        const uint64_t segLow = first_ + 2 * (segment_ << shift_);
+        const size_t bits = static_cast<size_t>(std::min<uint64_t>(segBits, (end_ - segLow + 1) / 2));
+        const uint64_t last = segLow + 2 * (bits - 1);
+        uint64_t* words = &words_[0];
+        presieve_.fill(words, segLow, bits);
+
+        // Sieving primes join once their square is in reach.
+        for (uint64_t p = source_.peek(); p != 0 && p * p <= last; p = source_.peek()) {
+            source_.pop();
+            uint64_t offset; // from segLow to the first odd multiple >= max(p^2, segLow)
+            if (p * p >= segLow) {
+                offset = p * p - segLow;
+            } else {
+                uint64_t r = segLow % p;
+                offset = r ? p - r : 0;
+                if (offset & 1)
+                    offset += p;
+            }
+            uint64_t bit = offset / 2;
+            if (p < segBits) {
+                smallPrimes_.push_back(static_cast<uint32_t>(p));
+                smallNext_.push_back(static_cast<uint32_t>(bit));
+            } else {
+                push(segment_ + (bit >> shift_), static_cast<uint32_t>(p), static_cast<uint32_t>(bit & (segBits - 1)));
+            }
+        }
+
+        for (size_t k = 0; k < smallPrimes_.size(); ++k) {
+            uint32_t p = smallPrimes_[k];
+            uint64_t i = smallNext_[k];
+            for (; i < bits; i += p)
+                words[i >> 6] |= 1ULL << (i & 63);
+            smallNext_[k] = static_cast<uint32_t>(i - bits);
+        }
+
+        BucketBlock*& head = buckets_[segment_ % buckets_.size()];
+        BucketBlock* block = head;
+        head = nullptr;
+        while (block) {
+            for (size_t e = 0; e < block->count; ++e) {
+                BucketEntry entry = block->entries[e];
+                if (entry.bit >= bits)
+                    continue; // past end in the last segment
+                words[entry.bit >> 6] |= 1ULL << (entry.bit & 63);
+                uint64_t nextBit = static_cast<uint64_t>(entry.bit) + entry.prime;
+                push(segment_ + (nextBit >> shift_), entry.prime, static_cast<uint32_t>(nextBit & (segBits - 1)));
+            }
+            BucketBlock* done = block;
+            block = block->next;
+            done->next = freeBlocks_;
+            freeBlocks_ = done;
+        }
+
+        for (size_t w = 0; w < (bits + 63) / 64; ++w) {
+            uint64_t live = ~words[w];
+            if ((w + 1) * 64 > bits)
+                live &= (1ULL << (bits & 63)) - 1;
+            const uint64_t base = segLow + 128 * w;
+            for (; live; live &= live - 1)
+                batch_.push_back(base + 2 * trailingZeros64(live));
+        }
+        ++segment_;
+    }
+
+    // Files a bucket prime under the segment holding its next multiple, or
+    // drops it when that is past the end of the range.
+    void push(uint64_t segment, uint32_t prime, uint32_t bit) {
+        if (segment >= segments_)
+            return;
+        BucketBlock*& head = buckets_[segment % buckets_.size()];
+        if (!head || head->count == kBlockEntries) {
+            BucketBlock* block = freeBlocks_;
+            if (block) {
+                freeBlocks_ = block->next;
+            } else {
+                blocks_.push_back(std::unique_ptr<BucketBlock>(new BucketBlock));
+                block = blocks_.back().get();
+            }
+            block->count = 0;
+            block->next = head;
+            head = block;
+        }
+        BucketEntry entry = {prime, bit};
+        head->entries[head->count++] = entry;
+    }
+
+    uint64_t end_;
+    uint64_t first_;    // first odd number >= max(start, 3)
+    uint64_t segment_;  // index of the next segment to sieve
+    uint64_t segments_; // segments in the range
+    unsigned shift_;    // log2 of bits per segment
+    bool two_;          // 2 is in the range and not yet handed out
+    std::vector<uint64_t> words_;
+    Presieve presieve_;
+    BasePrimeSource source_;
+    std::vector<uint32_t> smallPrimes_;
+    std::vector<uint32_t> smallNext_; // bit offset of each small prime's next multiple in the next segment
+    std::vector<BucketBlock*> buckets_; // ring indexed by segment
+    std::vector<std::unique_ptr<BucketBlock>> blocks_;
+    BucketBlock* freeBlocks_;
+    std::vector<uint64_t> batch_;
+    size_t pos_;
+};
+
+// Calls f(primes, count) for each batch of the primes in [start, end), in
+// increasing order.
+template <typename F>
+void forEachPrime(uint64_t start, uint64_t end, F f) {
+    PrimeStream stream(start, end);
+    const uint64_t* primes;
+    size_t count;
+    while (stream.nextBatch(primes, count))
+        f(primes, count);
+}
+
+// Aggregates over a run of consecutive primes.
+struct PrimeRangeStats {
+    uint64_t count;
+    uint64_t sumLow, sumHigh; // 128-bit sum of the primes
+    uint64_t first, last;     // 0 while count is 0
+    uint64_t twins;           // pairs p, p + 2 both in the range
+    uint64_t maxGap;          // largest distance between consecutive primes
+    uint64_t maxGapAfter;     // the prime that gap starts at
+    std::vector<uint64_t> gaps; // gaps[g / 2]: consecutive primes g apart (gaps[0] is 2 -> 3)
+
+    PrimeRangeStats() : count(0), sumLow(0), sumHigh(0), first(0), last(0), twins(0), maxGap(0), maxGapAfter(0) {}
+
+    void add(const uint64_t* primes, size_t n) {
+        if (n == 0)
+            return;
+        // Gaps are taken from the last prime seen; the very first prime has
+        // none and only opens the run.
+        size_t i = 0;
+        if (count == 0) {
+            first = last = primes[0];
+            i = 1;
+        }
+        uint64_t prev = last;
+        for (; i < n; ++i) {
+            uint64_t p = primes[i];
+            addGap(p - prev, prev);
+            prev = p;
+        }
+        for (size_t k = 0; k < n; ++k)
+            addToSum(primes[k]);
+        count += n;
+        last = primes[n - 1];
+    }
+
+    // Appends the stats of the range right after this one.
+    void merge(const PrimeRangeStats& next) {
+        if (next.count == 0)
+            return;
+        if (count == 0) {
+            *this = next;
+            return;
+        }
+        addGap(next.first - last, last);
+        twins += next.twins;
+        if (next.maxGap > maxGap) {
+            maxGap = next.maxGap;
+            maxGapAfter = next.maxGapAfter;
+        }
+        if (next.gaps.size() > gaps.size())
+            gaps.resize(next.gaps.size(), 0);
+        for (size_t g = 0; g < next.gaps.size(); ++g)
+            gaps[g] += next.gaps[g];
+        uint64_t low = sumLow + next.sumLow;
+        sumHigh += next.sumHigh + (low < sumLow);
+        sumLow = low;
+        count += next.count;
+        last = next.last;
+    }
+
+    double meanGap() const { return count > 1 ? static_cast<double>(last - first) / (count - 1) : 0.0; }
+
+    // The 128-bit sum in decimal.
+    std::string sum() const {
+        // Long division by 10 on 32-bit limbs, most significant first.
+        uint32_t limbs[4] = {static_cast<uint32_t>(sumHigh >> 32), static_cast<uint32_t>(sumHigh),
+                             static_cast<uint32_t>(sumLow >> 32), static_cast<uint32_t>(sumLow)};
+        std::string digits;
+        for (;;) {
+            uint64_t rem = 0;
+            bool zero = true;
+            for (int k = 0; k < 4; ++k) {
+                uint64_t cur = (rem << 32) | limbs[k];
+                limbs[k] = static_cast<uint32_t>(cur / 10);
+                rem = cur % 10;
+                zero = zero && limbs[k] == 0;
+            }
+            digits.insert(digits.begin(), static_cast<char>('0' + rem));
+            if (zero)
+                return digits;
+        }
+    }
+
+private:
+    // Records the gap between consecutive primes `after` and after + gap.
+    void addGap(uint64_t gap, uint64_t after) {
+        if (gap / 2 >= gaps.size())
+            gaps.resize(gap / 2 + 1, 0);
+        ++gaps[gap / 2];
+        twins += gap == 2;
+        if (gap > maxGap) {
+            maxGap = gap;
+            maxGapAfter = after;
+        }
+    }
+
+    void addToSum(uint64_t p) {
+        sumLow += p;
+        sumHigh += sumLow < p;
+    }
+};
+
+// Stats of the primes in [start, end), split over the pool. Each chunk runs
+// its own PrimeStream and so sieves its own primes up to sqrt(end), which
+// costs about as much as sieving a window of width sqrt(end). Chunks are
+// therefore kept at least 4 sqrt(end) wide where the range allows, but
+// never fewer than one per thread: a repeated setup on an otherwise idle
+// thread is cheaper than leaving that thread out.
+inline PrimeRangeStats primeRangeStats(WorkStealingPool& pool, uint64_t start, uint64_t end) {
+    if (start >= end)
+        return PrimeRangeStats();
+    const uint64_t width = end - start;
+    const uint64_t threads = pool.size();
+    const uint64_t minChunk = std::max<uint64_t>(1ULL << 24, 4 * isqrt64(end));
+    uint64_t chunkCount = std::min(std::max(width / minChunk, threads), threads * 4);
+    chunkCount = std::max<uint64_t>(1, std::min(chunkCount, width >> 24));
+    std::vector<PrimeRangeStats> chunks(chunkCount);
+    pool.run(chunkCount, [&](unsigned, uint64_t k) {
+        uint64_t low = start + width / chunkCount * k;
+        uint64_t high = k + 1 == chunkCount ? end : start + width / chunkCount * (k + 1);
+        PrimeRangeStats& stats = chunks[k];
+        forEachPrime(low, high, [&](const uint64_t* primes, size_t count) { stats.add(primes, count); });
+    });
+    PrimeRangeStats total;
+    for (size_t k = 0; k < chunks.size(); ++k)
+        total.merge(chunks[k]);
+    return total;
+}
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef PROC_BACKEND_H
+#define PROC_BACKEND_H
+
+// Linux backend for getCPUUsage / getRAMUsage / getDiskUsage.
+// The /proc files are opened once and re-read with pread() into a fixed
+// buffer, so a sample costs a few syscalls and no heap allocation. With a
+// ProcTap installed (proc_capture.h), reads are recorded or replayed.
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/statvfs.h>
+
+#include "proc_capture.h"
+
+// A /proc file kept open for the life of the process and re-read from
+// offset 0 on every sample.
+template <size_t BufSize>
+struct ProcFile {
+    int fd;
+    int source; // id with the installed tap, if any
+    size_t len;
+    char buf[BufSize];
+
+    explicit ProcFile(const char* path)
+        : fd(open(path, O_RDONLY | O_CLOEXEC)), source(procTap() ? procTap()->source(path) : -1), len(0) {
+        buf[0] = '\0';
+    }
+    ~ProcFile() {
+        if (fd >= 0)
+            close(fd);
+    }
+    ProcFile(const ProcFile&) = delete;
+    ProcFile& operator=(const ProcFile&) = delete;
+
+    bool read() {
+        if (ProcTap* tap = procTap())
+            return tap->read(source, fd, buf, BufSize, len);
+        if (fd < 0)
+            return false;
+        ssize_t n = pread(fd, buf, BufSize - 1, 0);
+        if (n <= 0)
+            return false;
+        len = static_cast<size_t>(n);
+        buf[len] = '\0';
+        return true;
+    }
+};
+
+// access(path, F_OK) through the installed tap, so that the check is
+// captured and replayed with the reads it decides on.
+inline bool procPathExists(const char* path) {
+    if (ProcTap* tap = procTap())
+        return tap->exists(path);
+    return access(path, F_OK) == 0;
+}
+
+// Reads one unsigned decimal field, skipping leading blanks but not newlines.
+// Returns false at end of line so callers can tell missing fields from zeros.
+inline bool scanField(const char*& p, unsigned long long& value) {
+    while (*p == ' ' || *p == '\t')
+        ++p;
+    if (*p < '0' || *p > '9')
+        return false;
+    unsigned long long v = 0;
+    while (*p >= '0' && *p <= '9')
+        v = v * 10 + static_cast<unsigned>(*p++ - '0');
+    value = v;
+    return true;
+}
+
+inline const char* nextLine(const char* p) {
+    while (*p && *p != '\n')
+        ++p;
+    return *p ? p + 1 : p;
+}
+
+// Jiffies from one "cpu" line of /proc/stat. busy excludes idle and iowait;
+// guest time is already counted in user, so it is not added again.
+struct CpuTimes {
+    unsigned long long busy;
+    unsigned long long total;
+};
+
+// p points just past the "cpuN" label.
+inline bool parseCpuLine(const char* p, CpuTimes& times) {
+    unsigned long long fields[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    int n = 0;
+    while (n < 8 && scanField(p, fields[n]))
+        ++n;
+    if (n < 4)
+        return false;
+    unsigned long long total = 0;
+    for (int i = 0; i < 8; ++i)
+        total += fields[i];
+    times.total = total;
+    times.busy = total - fields[3] - fields[4];
+    return true;
+}
+
+struct CpuSampler {
+    ProcFile<512> stat; // only the aggregate first line is needed
+    CpuTimes prev;
+
+    CpuSampler() : stat("/proc/stat"), prev{0, 0} {}
+};
+
+inline bool sampleCPU(CpuSampler& s, double& cpu_usage) {
+    if (!s.stat.read() || std::strncmp(s.stat.buf, "cpu ", 4) != 0)
+        return false;
+    CpuTimes now;
+    if (!parseCpuLine(s.stat.buf + 3, now))
+        return false;
+
+    double busy = static_cast<double>(now.busy - s.prev.busy);
+    double total = static_cast<double>(now.total - s.prev.total);
+    s.prev = now;
+
+    cpu_usage = total > 0 ? (busy / total) * 100.0 : 0.0;
+    return true;
+}
+
+struct RamSampler {
+    ProcFile<2048> meminfo;
+
+    RamSampler() : meminfo("/proc/meminfo") {}
+};
+
+inline bool sampleRAM(RamSampler& s, double& ram_usage) {
+    if (!s.meminfo.read())
+        return false;
+
+    unsigned long long totalKB = 0, availKB = 0;
+    bool haveTotal = false, haveAvail = false;
+    for (const char* p = s.meminfo.buf; *p && !(haveTotal && haveAvail); p = nextLine(p)) {
+        if (!haveTotal && std::strncmp(p, "MemTotal:", 9) == 0) {
+            const char* q = p + 9;
+            haveTotal = scanField(q, totalKB);
+        } else if (!haveAvail && std::strncmp(p, "MemAvailable:", 13) == 0) {
+            const char* q = p + 13;
+            haveAvail = scanField(q, availKB);
+        }
+    }
+    if (!haveTotal || !haveAvail || totalKB == 0)
+        return false;
+
+    ram_usage = (static_cast<double>(totalKB - availKB) / totalKB) * 100.0;
+    return true;
+}
+
+inline bool sampleDisk(const char* path, double& disk_usage) {
+    struct statvfs vfs;
+    if (statvfs(path, &vfs) != 0 || vfs.f_blocks == 0)
+        return false;
+
+    // Same definition as GetDiskFreeSpaceEx's total free bytes: reserved
+    // blocks count as free.
+    double totalBlocks = static_cast<double>(vfs.f_blocks);
+    double freeBlocks = static_cast<double>(vfs.f_bfree);
+
+    disk_usage = ((totalBlocks - freeBlocks) / totalBlocks) * 100.0;
+    return true;
+}
+
+inline bool getCPUUsage(double& cpu_usage) {
+    static CpuSampler sampler;
+    if (!sampleCPU(sampler, cpu_usage)) {
+        std::cerr << "Error: Unable to read /proc/stat." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline bool getRAMUsage(double& ram_usage) {
+    static RamSampler sampler;
+    if (!sampleRAM(sampler, ram_usage)) {
+        std::cerr << "Error: Unable to read /proc/meminfo." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline bool getDiskUsage(double& disk_usage) {
+    if (!sampleDisk("/", disk_usage)) {
+        std::cerr << "Error: Unable to get disk space." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,254 @@
+#ifndef PROC_CAPTURE_H
+#define PROC_CAPTURE_H
+
+// Capture and replay of the raw /proc and /sys inputs.
+//
+// Every ProcFile read goes through the tap when one is installed. In
+// capture mode the tap does the pread itself and appends the bytes it got
+// to a file, tagged with the source path and a monotonic timestamp. In
+// replay mode nothing is read from the system: each ProcFile is matched to
+// a recorded source by path and gets that source's records back in order,
+// so the parsers and statistics run on exactly the recorded input, as fast
+// as the CPU allows. The replay clock (the timestamp of the last record
+// handed out) stands in for CLOCK_MONOTONIC in the rate collectors, which
+// keeps replayed rates identical to the captured run. The existence checks
+// that decide what gets sampled (which /sys/block entries are whole disks,
+// whether a cgroup directory is there) go through procPathExists() and are
+// captured the same way.
+//
+// Inputs that do not go through ProcFile (statvfs for disk usage, the
+// per-process scan) are not captured. The tap is not thread-safe; install
+// it before any collector is constructed and sample from one thread.
+//
+// File layout: the 8-byte magic, then records, each a CaptureRecordHeader
+// followed by `length` bytes. A source record carries the path and comes
+// before the first data or exists record of its source. An exists record
+// holds one byte, 1 if the path existed. Native byte order.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+const char kCaptureMagic[8] = {'R', 'E', 'S', 'M', 'C', 'A', 'P', '1'};
+
+struct CaptureRecordHeader {
+    uint32_t type; // CAPTURE_SOURCE or CAPTURE_DATA
+    uint32_t source;
+    uint32_t length;
+    uint32_t reserved;
+    int64_t timestampNs; // CLOCK_MONOTONIC at the read; 0 for sources
+};
+
+enum CaptureRecordType { CAPTURE_SOURCE = 1, CAPTURE_DATA = 2, CAPTURE_EXISTS = 3 };
+
+class ProcTap {
+public:
+    ProcTap() : out_(nullptr), replaying_(false), exhausted_(false), clockNs_(0), records_(0) {}
+
+    ~ProcTap() {
+        if (out_)
+            fclose(out_);
+    }
+
+    ProcTap(const ProcTap&) = delete;
+    ProcTap& operator=(const ProcTap&) = delete;
+
+    // Starts recording every read to path.
+    bool capture(const char* path) {
+        out_ = fopen(path, "wb");
+        if (!out_ || fwrite(kCaptureMagic, sizeof(kCaptureMagic), 1, out_) != 1) {
+            if (out_)
+                fclose(out_);
+            out_ = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    // Loads a capture; reads are served from it from now on.
+    bool replay(const char* path) {
+        FILE* in = fopen(path, "rb");
+        if (!in)
+            return false;
+        data_.clear();
+        char chunk[1 << 16];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0)
+            data_.insert(data_.end(), chunk, chunk + n);
+        fclose(in);
+        if (data_.size() < sizeof(kCaptureMagic) || std::memcmp(&data_[0], kCaptureMagic, sizeof(kCaptureMagic)) != 0)
+            return false;
+
+        size_t pos = sizeof(kCaptureMagic);
+        while (pos + sizeof(CaptureRecordHeader) <= data_.size()) {
+            CaptureRecordHeader h;
+            std::memcpy(&h, &data_[pos], sizeof(h));
+            pos += sizeof(h);
+            if (h.length > data_.size() - pos)
+                break; // truncated tail, e.g. the capture was killed mid-write
+            if (h.type == CAPTURE_SOURCE) {
+                if (h.source >= recorded_.size())
+                    recorded_.resize(h.source + 1);
+                recorded_[h.source].path.assign(&data_[pos], h.length);
+            } else if (h.type == CAPTURE_DATA && h.source < recorded_.size()) {
+                Span s = {pos, h.length, h.timestampNs};
+                recorded_[h.source].reads.push_back(s);
+                ++records_;
+            } else if (h.type == CAPTURE_EXISTS && h.source < recorded_.size() && h.length == 1) {
+                recorded_[h.source].exists = data_[pos] ? 1 : 0;
+            }
+            pos += h.length;
+        }
+        replaying_ = true;
+        return true;
+    }
+
+    bool replaying() const { return replaying_; }
+
+    // Id for a file being opened. Files opened more than once (two
+    // samplers on /proc/stat) share one source, so replay hands their reads
+    // out in the order they were captured. -1 when replaying a path that
+    // was never recorded.
+    int source(const char* path) {
+        for (size_t i = 0; i < recorded_.size(); ++i) {
+            if (recorded_[i].path == path)
+                return static_cast<int>(i);
+        }
+        if (replaying_)
+            return -1;
+        uint32_t id = static_cast<uint32_t>(recorded_.size());
+        recorded_.push_back(Source());
+        recorded_.back().path = path;
+        if (out_) {
+            CaptureRecordHeader h = {CAPTURE_SOURCE, id, static_cast<uint32_t>(std::strlen(path)), 0, 0};
+            fwrite(&h, sizeof(h), 1, out_);
+            fwrite(path, 1, h.length, out_);
+        }
+        return static_cast<int>(id);
+    }
+
+    // Fills buf (size bytes, NUL-terminated) the way ProcFile::read would.
+    bool read(int source, int fd, char* buf, size_t size, size_t& len) {
+        if (replaying_) {
+            if (source < 0)
+                return false;
+            Source& s = recorded_[source];
+            if (s.cursor == s.reads.size()) {
+                exhausted_ = true;
+                return false;
+            }
+            const Span& r = s.reads[s.cursor++];
+            len = r.length < size - 1 ? r.length : size - 1;
+            std::memcpy(buf, &data_[r.offset], len);
+            buf[len] = '\0';
+            clockNs_ = r.timestampNs;
+            return true;
+        }
+
+        if (fd < 0)
+            return false;
+        ssize_t n = pread(fd, buf, size - 1, 0);
+        if (n <= 0)
+            return false;
+        len = static_cast<size_t>(n);
+        buf[len] = '\0';
+        if (out_ && source >= 0) {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            CaptureRecordHeader h = {CAPTURE_DATA, static_cast<uint32_t>(source), static_cast<uint32_t>(len), 0,
+                                     static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec};
+            fwrite(&h, sizeof(h), 1, out_);
+            fwrite(buf, 1, len, out_);
+            ++records_;
+        }
+        return true;
+    }
+
+    // Whether path exists, by access(F_OK). Captured and replayed like a
+    // read. Captures made before these checks were recorded have none, and
+    // fall back to the live system.
+    bool exists(const char* path) {
+        if (replaying_) {
+            for (size_t i = 0; i < recorded_.size(); ++i) {
+                if (recorded_[i].path == path && recorded_[i].exists >= 0)
+                    return recorded_[i].exists == 1;
+            }
+            return access(path, F_OK) == 0;
+        }
+        bool found = access(path, F_OK) == 0;
+        int id = source(path);
+        if (out_ && id >= 0) {
+            CaptureRecordHeader h = {CAPTURE_EXISTS, static_cast<uint32_t>(id), 1, 0, 0};
+            char flag = found ? 1 : 0;
+            fwrite(&h, sizeof(h), 1, out_);
+            fwrite(&flag, 1, 1, out_);
+        }
+        return found;
+    }
+
+    // Timestamp of the last replayed read.
+    long long clockNs() const { return clockNs_; }
+
+    // Replays every source from its first record again.
+    void rewind() {
+        for (size_t i = 0; i < recorded_.size(); ++i)
+            recorded_[i].cursor = 0;
+        exhausted_ = false;
+    }
+
+    // A replayed source ran out of records.
+    bool exhausted() const { return exhausted_; }
+
+    // Data records captured or loaded.
+    size_t records() const { return records_; }
+
+    // Records loaded for one recorded path (0 if none).
+    size_t records(const char* path) const {
+        for (size_t i = 0; i < recorded_.size(); ++i) {
+            if (recorded_[i].path == path)
+                return recorded_[i].reads.size();
+        }
+        return 0;
+    }
+
+    void flush() {
+        if (out_)
+            fflush(out_);
+    }
+
+private:
+    struct Span {
+        size_t offset;
+        size_t length;
+        int64_t timestampNs;
+    };
+
+    struct Source {
+        std::string path;
+        std::vector<Span> reads;
+        size_t cursor;
+        int exists; // recorded access() result: 1, 0, or -1 if never checked
+
+        Source() : cursor(0), exists(-1) {}
+    };
+
+    FILE* out_;
+    bool replaying_;
+    bool exhausted_;
+    long long clockNs_;
+    size_t records_;
+    std::vector<char> data_;
+    std::vector<Source> recorded_;
+};
+
+// The installed tap, or null for plain reads.
+inline ProcTap*& procTap() {
+    static ProcTap* tap = nullptr;
+    return tap;
+}
+
+#endif
@@ -0,0 +1,265 @@
+#ifndef PROC_TOP_H
+#define PROC_TOP_H
+
+// Per-process CPU and RSS accounting with top-N selection.
+//
+// Every known process keeps /proc/<pid>/stat open and re-reads it with
+// pread for name, CPU time and RSS. Its utime and stime cover all threads
+// of the process; /proc/<pid>/schedstat would be cheaper but counts only
+// the thread-group leader, which hides servers whose work runs in worker
+// threads. A descriptor stays bound to the task it was opened for: once
+// that task exits the read fails and the entry is dropped, even if the pid
+// has been reused. /proc itself is only re-listed when the "last pid"
+// field of /proc/loadavg moves, i.e. when something new was created since
+// the previous scan. Top-N uses bounded heaps, so selection is
+// O(P log N) with no allocation after warm-up.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <unordered_map>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "proc_backend.h"
+
+struct ProcessUsage {
+    int pid;
+    char name[16];
+    double cpu;                 // percent of one core over the last interval
+    unsigned long long rssKB;
+};
+
+class ProcessTable {
+public:
+    explicit ProcessTable(size_t topN = 5)
+        : topN_(topN), loadavg_("/proc/loadavg"), lastPid_(~0ULL), prevScanNs_(0),
+          nsPerTick_(1000000000ULL / static_cast<unsigned long long>(sysconf(_SC_CLK_TCK))),
+          pageKB_(static_cast<unsigned long long>(sysconf(_SC_PAGESIZE)) / 1024) {
+        // One descriptor per process: lift the soft limit to the hard one.
+        struct rlimit lim;
+        if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+            lim.rlim_cur = lim.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &lim);
+        }
+        topCpu_.reserve(topN_);
+        topRss_.reserve(topN_);
+    }
+
+    ~ProcessTable() {
+        for (size_t i = 0; i < entries_.size(); ++i)
+            closeEntry(entries_[i]);
+    }
+
+    ProcessTable(const ProcessTable&) = delete;
+    ProcessTable& operator=(const ProcessTable&) = delete;
+
+    // Refreshes every process and the top-N lists. The first scan only
+    // establishes baselines, so CPU figures start at the second one.
+    bool scan() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        long long nowNs = static_cast<long long>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+        double elapsedNs = prevScanNs_ ? static_cast<double>(nowNs - prevScanNs_) : 0.0;
+        prevScanNs_ = nowNs;
+
+        if (newPidsPossible())
+            discover();
+
+        topCpu_.clear();
+        topRss_.clear();
+        for (size_t i = 0; i < entries_.size();) {
+            Entry& e = entries_[i];
+            unsigned long long cpuNs, rssPages;
+            if (!readStat(e.fd, cpuNs, rssPages)) {
+                remove(i); // exited; entries_[i] now holds another process
+                continue;
+            }
+
+            ProcessUsage usage;
+            usage.pid = e.pid;
+            std::memcpy(usage.name, e.name, sizeof(usage.name));
+            usage.cpu = (e.seen && elapsedNs > 0) ? (cpuNs - e.prevCpuNs) / elapsedNs * 100.0 : 0.0;
+            usage.rssKB = rssPages * pageKB_;
+            e.prevCpuNs = cpuNs;
+            e.seen = true;
+
+            offer(topCpu_, usage, byCpu);
+            offer(topRss_, usage, byRss);
+            ++i;
+        }
+
+        std::sort_heap(topCpu_.begin(), topCpu_.end(), byCpu);
+        std::sort_heap(topRss_.begin(), topRss_.end(), byRss);
+        return true;
+    }
+
+    // Sorted highest first.
+    const std::vector<ProcessUsage>& topCpu() const { return topCpu_; }
+    const std::vector<ProcessUsage>& topRss() const { return topRss_; }
+    size_t processes() const { return entries_.size(); }
+
+private:
+    struct Entry {
+        int pid;
+        int fd; // /proc/<pid>/stat
+        bool seen;
+        unsigned long long prevCpuNs;
+        char name[16];
+    };
+
+    // Heap comparators: "a ranks above b", which makes the heap top the
+    // smallest kept element, ready to be evicted.
+    static bool byCpu(const ProcessUsage& a, const ProcessUsage& b) { return a.cpu > b.cpu; }
+    static bool byRss(const ProcessUsage& a, const ProcessUsage& b) { return a.rssKB > b.rssKB; }
+
+    template <typename Less>
+    void offer(std::vector<ProcessUsage>& heap, const ProcessUsage& usage, Less ranksAbove) {
+        if (topN_ == 0)
+            return;
+        if (heap.size() < topN_) {
+            heap.push_back(usage);
+            std::push_heap(heap.begin(), heap.end(), ranksAbove);
+        } else if (ranksAbove(usage, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), ranksAbove);
+            heap.back() = usage;
+            std::push_heap(heap.begin(), heap.end(), ranksAbove);
+        }
+    }
+
+    bool newPidsPossible() {
+        if (!loadavg_.read())
+            return true;
+        // "0.15 0.14 0.09 2/71 5337": the last field is the last pid handed out.
+        const char* p = loadavg_.buf + loadavg_.len;
+        while (p > loadavg_.buf && (p[-1] < '0' || p[-1] > '9'))
+            --p;
+        while (p > loadavg_.buf && p[-1] >= '0' && p[-1] <= '9')
+            --p;
+        unsigned long long last;
+        if (!scanField(p, last))
+            return true;
+        bool changed = last != lastPid_;
+        lastPid_ = last;
+        return changed;
+    }
+
+    void discover() {
+        DIR* dir = opendir("/proc");
+        if (!dir)
+            return;
+        while (struct dirent* d = readdir(dir)) {
+            const char* p = d->d_name;
+            unsigned long long pid;
+            if (!scanField(p, pid) || *p != '\0')
+                continue;
+            std::unordered_map<int, size_t>::iterator it = index_.find(static_cast<int>(pid));
+            if (it != index_.end())
+                continue;
+            add(static_cast<int>(pid));
+        }
+        closedir(dir);
+    }
+
+    void add(int pid) {
+        char path[40];
+        Entry e;
+        e.pid = pid;
+        e.seen = false;
+        e.prevCpuNs = 0;
+        e.name[0] = '\0';
+
+        snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+        e.fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (e.fd < 0)
+            return;
+        readName(e.fd, e.name);
+        index_[pid] = entries_.size();
+        entries_.push_back(e);
+    }
+
+    static void closeEntry(const Entry& e) {
+        if (e.fd >= 0)
+            close(e.fd);
+    }
+
+    void remove(size_t i) {
+        closeEntry(entries_[i]);
+        index_.erase(entries_[i].pid);
+        if (i + 1 != entries_.size()) {
+            entries_[i] = entries_.back();
+            index_[entries_[i].pid] = i;
+        }
+        entries_.pop_back();
+    }
+
+    bool readFile(int fd) {
+        ssize_t n = pread(fd, buf_, sizeof(buf_) - 1, 0);
+        if (n <= 0)
+            return false;
+        buf_[n] = '\0';
+        return true;
+    }
+
+    void readName(int fd, char (&name)[16]) {
+        if (!readFile(fd))
+            return;
+        const char* lparen = std::strchr(buf_, '(');
+        const char* rparen = std::strrchr(buf_, ')');
+        if (!lparen || !rparen || rparen < lparen)
+            return;
+        size_t len = std::min(static_cast<size_t>(rparen - lparen - 1), sizeof(name) - 1);
+        std::memcpy(name, lparen + 1, len);
+        name[len] = '\0';
+    }
+
+    // "pid (comm) state ppid ..." -- comm may hold spaces or
+    // parentheses, so fields are counted from the last ')'. utime and stime
+    // are fields 14 and 15 (clock ticks), rss is field 24.
+    bool readStat(int fd, unsigned long long& cpuNs, unsigned long long& rssPages) {
+        if (!readFile(fd))
+            return false;
+        const char* rparen = std::strrchr(buf_, ')');
+        if (!rparen || !rparen[1])
+            return false;
+
+        const char* p = rparen + 2; // field 3, the state character
+        if (*p)
+            ++p;
+        unsigned long long value = 0, utime = 0, stime = 0;
+        for (int field = 4; field <= 24; ++field) {
+            // priority and nice may be negative; their sign is not needed.
+            while (*p == ' ')
+                ++p;
+            if (*p == '-')
+                ++p;
+            if (!scanField(p, value))
+                return false;
+            if (field == 14)
+                utime = value;
+            else if (field == 15)
+                stime = value;
+        }
+        cpuNs = (utime + stime) * nsPerTick_;
+        rssPages = value;
+        return true;
+    }
+
+    size_t topN_;
+    ProcFile<128> loadavg_;
+    unsigned long long lastPid_;
+    long long prevScanNs_;
+    unsigned long long nsPerTick_;
+    unsigned long long pageKB_;
+    std::vector<Entry> entries_;
+    std::unordered_map<int, size_t> index_;
+    std::vector<ProcessUsage> topCpu_;
+    std::vector<ProcessUsage> topRss_;
+    char buf_[1024];
+};
+
+#endif
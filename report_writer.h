@@ -0,0 +1,246 @@
+#ifndef REPORT_WRITER_H
+#define REPORT_WRITER_H
+
+// Writes rendered reports from a dedicated thread so the sampler never
+// blocks on file I/O.
+//
+// Reports are handed over through a triple buffer: the producer fills its
+// own buffer and swaps it into the shared middle slot with one atomic
+// exchange, the writer swaps the middle slot with its own. Neither side
+// ever waits for the other. If the writer falls behind, a newer report
+// simply replaces the pending one (counted as coalesced), since only the
+// latest report matters for the file.
+//
+// Each report is written to "<path>.tmp" and renamed over <path>, so
+// readers see either the previous or the new file, never a partial one.
+// Each write is timed under the "report-write" latency stage.
+//
+// LogAppender is the same idea for logs, where every line matters: text
+// is queued instead of replaced and appended to the file in order.
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "instrumentation.h"
+
+class ReportWriter {
+public:
+    explicit ReportWriter(const std::string& path)
+        : path_(path), tmpPath_(path + ".tmp"), wakeFd_(eventfd(0, EFD_CLOEXEC)), back_(0),
+          middle_(1), front_(2), stopping_(false), written_(0), coalesced_(0), failed_(0),
+          writeStage_(stageRegistry().stage("report-write")) {
+        if (wakeFd_ < 0)
+            std::cerr << "Error: Unable to create report writer event." << std::endl;
+        else
+            thread_ = std::thread(&ReportWriter::run, this);
+    }
+
+    ~ReportWriter() {
+        if (thread_.joinable()) {
+            stopping_.store(true, std::memory_order_release);
+            wake();
+            thread_.join();
+        }
+        if (wakeFd_ >= 0)
+            close(wakeFd_);
+    }
+
+    ReportWriter(const ReportWriter&) = delete;
+    ReportWriter& operator=(const ReportWriter&) = delete;
+
+    // Producer side; call from one thread only. Never blocks on I/O.
+    void submit(const std::string& report) {
+        buffers_[back_].assign(report);
+        unsigned prev = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel);
+        back_ = prev & kIndex;
+        if (prev & kFresh)
+            coalesced_.fetch_add(1, std::memory_order_relaxed);
+        wake();
+    }
+
+    unsigned long long written() const { return written_.load(std::memory_order_relaxed); }
+    unsigned long long coalesced() const { return coalesced_.load(std::memory_order_relaxed); }
+    unsigned long long failed() const { return failed_.load(std::memory_order_relaxed); }
+
+private:
+    static const unsigned kIndex = 3;
+    static const unsigned kFresh = 4;
+
+    void wake() {
+        uint64_t one = 1;
+        ssize_t n = write(wakeFd_, &one, sizeof(one));
+        (void)n; // fails only if the counter would overflow
+    }
+
+    void run() {
+        while (true) {
+            uint64_t events;
+            if (read(wakeFd_, &events, sizeof(events)) != sizeof(events))
+                continue;
+            // Drain before exiting so the last report is not lost.
+            bool stopping = stopping_.load(std::memory_order_acquire);
+            if (middle_.load(std::memory_order_acquire) & kFresh) {
+                unsigned prev = middle_.exchange(front_, std::memory_order_acq_rel);
+                front_ = prev & kIndex;
+                ScopedStageTimer timer(writeStage_);
+                if (publish(buffers_[front_]))
+                    written_.fetch_add(1, std::memory_order_relaxed);
+                else
+                    failed_.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (stopping)
+                return;
+        }
+    }
+
+    bool publish(const std::string& report) {
+        int fd = open(tmpPath_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            std::cerr << "Error: Could not open file " << tmpPath_ << std::endl;
+            return false;
+        }
+        const char* p = report.data();
+        size_t left = report.size();
+        while (left > 0) {
+            ssize_t n = write(fd, p, left);
+            if (n <= 0) {
+                close(fd);
+                unlink(tmpPath_.c_str());
+                std::cerr << "Error: Could not write file " << tmpPath_ << std::endl;
+                return false;
+            }
+            p += n;
+            left -= static_cast<size_t>(n);
+        }
+        close(fd);
+        if (rename(tmpPath_.c_str(), path_.c_str()) != 0) {
+            std::cerr << "Error: Could not replace file " << path_ << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    const std::string path_;
+    const std::string tmpPath_;
+    int wakeFd_;
+    std::string buffers_[3];
+    unsigned back_;               // producer only
+    std::atomic<unsigned> middle_; // index | kFresh when unread
+    unsigned front_;              // writer thread only
+    std::atomic<bool> stopping_;
+    std::atomic<unsigned long long> written_;
+    std::atomic<unsigned long long> coalesced_;
+    std::atomic<unsigned long long> failed_;
+    int writeStage_;
+    std::thread thread_;
+};
+
+// Appends text to a file from a dedicated thread. append() only copies
+// the text into a pending buffer under a mutex that the writer holds just
+// long enough to swap buffers, so the caller never waits on the disk.
+// Each write is timed under the given latency stage.
+class LogAppender {
+public:
+    LogAppender(const std::string& path, const char* stage)
+        : path_(path), fd_(open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)),
+          wakeFd_(eventfd(0, EFD_CLOEXEC)), stopping_(false), failed_(0), writeStage_(stageRegistry().stage(stage)) {
+        if (fd_ < 0)
+            std::cerr << "Error: Could not open file " << path << std::endl;
+        else if (wakeFd_ < 0)
+            std::cerr << "Error: Unable to create log writer event." << std::endl;
+        else
+            thread_ = std::thread(&LogAppender::run, this);
+    }
+
+    ~LogAppender() {
+        if (thread_.joinable()) {
+            stopping_.store(true, std::memory_order_release);
+            wake();
+            thread_.join();
+        }
+        if (wakeFd_ >= 0)
+            close(wakeFd_);
+        if (fd_ >= 0)
+            close(fd_);
+    }
+
+    LogAppender(const LogAppender&) = delete;
+    LogAppender& operator=(const LogAppender&) = delete;
+
+    void append(const std::string& text) {
+        if (!thread_.joinable() || text.empty())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pending_ += text;
+        }
+        wake();
+    }
+
+    unsigned long long failed() const { return failed_.load(std::memory_order_relaxed); }
+
+private:
+    void wake() {
+        uint64_t one = 1;
+        ssize_t n = write(wakeFd_, &one, sizeof(one));
+        (void)n; // fails only if the counter would overflow
+    }
+
+    void run() {
+        std::string text;
+        while (true) {
+            uint64_t events;
+            if (read(wakeFd_, &events, sizeof(events)) != sizeof(events))
+                continue;
+            // Drain before exiting so the last lines are not lost.
+            bool stopping = stopping_.load(std::memory_order_acquire);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                text.swap(pending_);
+            }
+            if (!text.empty()) {
+                ScopedStageTimer timer(writeStage_);
+                if (!writeAll(text))
+                    failed_.fetch_add(1, std::memory_order_relaxed);
+                text.clear();
+            }
+            if (stopping)
+                return;
+        }
+    }
+
+    bool writeAll(const std::string& text) {
+        const char* p = text.data();
+        size_t left = text.size();
+        while (left > 0) {
+            ssize_t n = write(fd_, p, left);
+            if (n <= 0) {
+                std::cerr << "Error: Could not write file " << path_ << std::endl;
+                return false;
+            }
+            p += n;
+            left -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    const std::string path_;
+    int fd_;
+    int wakeFd_;
+    std::mutex mutex_;
+    std::string pending_; // guarded by mutex_
+    std::atomic<bool> stopping_;
+    std::atomic<unsigned long long> failed_;
+    int writeStage_;
+    std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include <cstdlib>
+#include <iostream>
+#include <chrono>
+#include <ctime>
+#include <sstream>
+#include <string>
+
+#include "fleet.h"
+#include "report_writer.h"
+
+using namespace std;
+
+// Aggregator for many resmonitoring agents:
+//
+//   resaggregator --listen unix:/tmp/resmon.sock [--report-interval 1000] [--output fleet_usage.txt]
+//   resmonitoring --agent unix:/tmp/resmon.sock --agent-name web-1
+//
+// TCP works the same way, e.g. --listen :9200 and --agent aggregator:9200.
+
+string stringOption(int argc, char* argv[], const string& name, const string& fallback) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (name == argv[i])
+            return argv[i + 1];
+    }
+    return fallback;
+}
+
+string getCurrentTimestamp() {
+    char buffer[80];
+    time_t rawtime = time(nullptr);
+    struct tm timeinfo;
+    localtime_r(&rawtime, &timeinfo);
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
+    return buffer;
+}
+
+void writeFleet(stringstream& out, const FleetAggregator& fleet) {
+    const char* windowNames[3] = {"1m", "5m", "15m"};
+    for (int m = 0; m < kFleetMetrics; ++m) {
+        for (int w = 0; w < 3; ++w) {
+            FleetSummary s = fleet.summary(m, w);
+            out << "Fleet " << kFleetMetricLabels[m] << " " << windowNames[w] << ": avg " << s.average << "% min "
+                << s.min << "% max " << s.max << "%";
+            if (s.maxHost)
+                out << " (" << s.maxHost->name << ")";
+            out << " over " << s.hosts << " hosts" << endl;
+        }
+        writePercentiles(out, (string("Fleet ") + kFleetMetricLabels[m]).c_str(), fleet.percentiles(m));
+    }
+}
+
+void writeHosts(stringstream& out, const FleetAggregator& fleet) {
+    int64_t now = fleetClockNs();
+    out << "Hosts:" << endl;
+    for (size_t i = 0; i < fleet.hosts(); ++i) {
+        const HostStats& h = fleet.host(i);
+        out << "  " << h.name << (h.connections > 0 ? "" : " (disconnected)");
+        for (int m = 0; m < kFleetMetrics; ++m) {
+            const MetricState& s = h.metric(m);
+            out << " " << kFleetMetricLabels[m] << " " << s.stats.currentUsage << "% (1m "
+                << s.windows.history.summary(s.windows.oneMinute).average << "%)";
+        }
+        out << " samples " << h.samples << ", last seen " << (now - h.lastSeenNs) / 1e9 << "s ago" << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    string address = stringOption(argc, argv, "--listen", "unix:/tmp/resmon.sock");
+    string filename = stringOption(argc, argv, "--output", "fleet_usage.txt");
+    long long reportMs = atoll(stringOption(argc, argv, "--report-interval", "1000").c_str());
+    if (reportMs <= 0) {
+        cerr << "Error: Invalid value for --report-interval." << endl;
+        return 1;
+    }
+
+    FleetAggregator fleet;
+    if (!fleet.start(address))
+        return 1;
+    ReportWriter reportWriter(filename);
+    stringstream dataStream;
+
+    bool ok = fleet.run(chrono::milliseconds(reportMs), [&] {
+        dataStream.str("");
+        size_t connected = 0;
+        for (size_t i = 0; i < fleet.hosts(); ++i)
+            connected += fleet.host(i).connections > 0 ? 1 : 0;
+        dataStream << "FLEET RESMON :->" << endl;
+        dataStream << "Timestamp: " << getCurrentTimestamp() << endl;
+        dataStream << "Listening: " << address << endl;
+        dataStream << "Hosts: " << fleet.hosts() << " (" << connected << " connected, " << fleet.connections()
+                   << " connections)" << endl;
+        dataStream << "Received: " << fleet.frames() << " frames, " << fleet.bytes() << " bytes, "
+                   << fleet.protocolErrors() << " protocol errors" << endl;
+        dataStream << "--------------------------------------" << endl;
+        writeFleet(dataStream, fleet);
+        dataStream << "--------------------------------------" << endl;
+        writeHosts(dataStream, fleet);
+        reportWriter.submit(dataStream.str());
+    });
+    return ok ? 0 : 1;
+}
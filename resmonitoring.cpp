@@ -1,184 +1,540 @@
+#include <cstdlib>
 #include <iostream>
-#include <fstream>
-#include <Windows.h>
-#include <thread>
 #include <chrono>
 #include <ctime>
 #include <sstream>
-#include <mutex>
+#include <vector>
+
+#include "cgroup.h"
+#include "fleet.h"
+#include "high_frequency.h"
+#include "io_rates.h"
+#include "metrics_server.h"
+#include "monitor_core.h"
+#include "proc_top.h"
+#include "report_writer.h"
+#include "sample_log.h"
+#include "scheduler.h"
 
 using namespace std;
 
-struct UsageStats {
-    double currentUsage;
-    double maxUsage;
-    double totalUsage;
-    int count;
+// Schedules every collector of a core as its own task, at its interval.
+// Alerts raised by a sample wait in the detector's ring until the report
+// tick collects them.
+struct ScheduleCollectors {
+    SampleScheduler& scheduler;
+    vector<int> tasks;
+
+    template <typename C>
+    void operator()(MetricSlot<C>& slot) {
+        MetricSlot<C>* target = &slot;
+        tasks.push_back(scheduler.add(C::key(), slot.state.interval, [target] { target->sample(); }));
+    }
 };
 
-bool getCPUUsage(double& cpu_usage) {
-    FILETIME idleTime, kernelTime, userTime;
 
-    if (!GetSystemTimes(&idleTime, &kernelTime, &userTime)) {
-        cerr << "Error: Unable to get system times." << endl;
-        return false;
+string formatTime(long long seconds) {
+    long long hours = seconds / 3600;
+    long long minutes = (seconds % 3600) / 60;
+    long long secs = seconds % 60;
+
+    stringstream ss;
+    if (hours > 0) {
+        ss << hours << "h ";
     }
+    if (minutes > 0) {
+        ss << minutes << "m ";
+    }
+    ss << secs << "s";
 
-    static ULONGLONG prevIdleTime = 0, prevKernelTime = 0, prevUserTime = 0;
-    ULONGLONG idleTimeNow = (reinterpret_cast<ULONGLONG*>(&idleTime))[0];
-    ULONGLONG kernelTimeNow = (reinterpret_cast<ULONGLONG*>(&kernelTime))[0];
-    ULONGLONG userTimeNow = (reinterpret_cast<ULONGLONG*>(&userTime))[0];
+    return ss.str();
+}
 
-    double idle = idleTimeNow - prevIdleTime;
-    double kernel = kernelTimeNow - prevKernelTime;
-    double user = userTimeNow - prevUserTime;
-    double system = kernel + user;
+string getCurrentTimestamp() {
+    char buffer[80];
+    time_t rawtime;
+    struct tm timeinfo;
 
-    cpu_usage = ((system - idle) / system) * 100.0;
+    time(&rawtime);
+#ifdef _WIN32
+    localtime_s(&timeinfo, &rawtime);
+#else
+    localtime_r(&rawtime, &timeinfo);
+#endif
 
-    prevIdleTime = idleTimeNow;
-    prevKernelTime = kernelTimeNow;
-    prevUserTime = userTimeNow;
+    strftime(buffer, sizeof(buffer), "%I:%M:%S %p", &timeinfo);
+    string time_str(buffer);
+
+    strftime(buffer, sizeof(buffer), "%A, %d %B %Y (%Z)", &timeinfo);
+    string date_location_str(buffer);
 
-    return true;
+    return time_str + "\n" + date_location_str + "\n";
 }
 
-bool getRAMUsage(double& ram_usage) {
-    MEMORYSTATUSEX memoryStatus;
-    memoryStatus.dwLength = sizeof(memoryStatus);
-    if (!GlobalMemoryStatusEx(&memoryStatus)) {
-        cerr << "Error: Unable to get memory status." << endl;
-        return false;
+// Reads "--name <milliseconds>" from the command line.
+chrono::milliseconds intervalOption(int argc, char* argv[], const string& name, chrono::milliseconds fallback) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (name == argv[i]) {
+            long long ms = atoll(argv[i + 1]);
+            if (ms > 0)
+                return chrono::milliseconds(ms);
+            cerr << "Error: Invalid value for " << name << ", using " << fallback.count() << "ms." << endl;
+        }
     }
+    return fallback;
+}
 
-    double totalRAM = memoryStatus.ullTotalPhys / (1024.0 * 1024.0); // Convert bytes to MB
-    double usedRAM = (memoryStatus.ullTotalPhys - memoryStatus.ullAvailPhys) / (1024.0 * 1024.0); // Convert bytes to MB
-
-    ram_usage = (usedRAM / totalRAM) * 100.0;
+// Reads "--name <value>" from the command line.
+string stringOption(int argc, char* argv[], const string& name, const string& fallback) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (name == argv[i])
+            return argv[i + 1];
+    }
+    return fallback;
+}
 
-    return true;
+// Reads "--name <number>" from the command line.
+double doubleOption(int argc, char* argv[], const string& name, double fallback) {
+    string value = stringOption(argc, argv, name, "");
+    return value.empty() ? fallback : atof(value.c_str());
 }
 
-bool getDiskUsage(double& disk_usage) {
-    ULARGE_INTEGER freeBytesAvailable, totalNumberOfBytes, totalNumberOfFreeBytes;
+// Applies the alert options; "--<key>-alert <percent>" sets each metric's
+// threshold (0 turns it off).
+struct ConfigureAlerts {
+    int argc;
+    char** argv;
+    AlertConfig defaults;
+
+    template <typename C>
+    void operator()(MetricSlot<C>& slot) {
+        AlertConfig config = defaults;
+        config.threshold = doubleOption(argc, argv, string("--") + C::key() + "-alert", defaults.threshold);
+        slot.state.alerts.configure(config);
+    }
+};
 
-    if (!GetDiskFreeSpaceEx(NULL, &freeBytesAvailable, &totalNumberOfBytes, &totalNumberOfFreeBytes)) {
-        cerr << "Error: Unable to get disk space." << endl;
-        return false;
+void writeTopProcesses(stringstream& dataStream, const string& title, const vector<ProcessUsage>& processes) {
+    dataStream << title << ":" << endl;
+    for (size_t i = 0; i < processes.size(); ++i) {
+        dataStream << "  " << processes[i].pid << " " << processes[i].name << " CPU " << processes[i].cpu
+                   << "% RSS " << processes[i].rssKB / 1024 << " MB" << endl;
     }
+}
 
-    double totalDiskSpace = totalNumberOfBytes.QuadPart / (1024.0 * 1024.0 * 1024.0); // Convert bytes to GB
-    double freeDiskSpace = totalNumberOfFreeBytes.QuadPart / (1024.0 * 1024.0 * 1024.0); // Convert bytes to GB
+void writeDiskRates(stringstream& dataStream, const vector<DiskRate>& disks) {
+    dataStream << "Disk I/O:" << endl;
+    for (size_t i = 0; i < disks.size(); ++i) {
+        const DiskRate& d = disks[i];
+        dataStream << "  " << d.name << " read " << d.readBytes / (1024.0 * 1024.0) << " MB/s (" << d.readOps
+                   << " IOPS) write " << d.writeBytes / (1024.0 * 1024.0) << " MB/s (" << d.writeOps
+                   << " IOPS) await " << d.awaitMs << " ms util " << d.util << "% queue " << d.queueDepth << endl;
+    }
+}
 
-    disk_usage = ((totalDiskSpace - freeDiskSpace) / totalDiskSpace) * 100.0;
+void writeNetRates(stringstream& dataStream, const vector<NetRate>& interfaces) {
+    dataStream << "Network:" << endl;
+    for (size_t i = 0; i < interfaces.size(); ++i) {
+        const NetRate& n = interfaces[i];
+        dataStream << "  " << n.name << " rx " << n.rxBytes / (1024.0 * 1024.0) << " MB/s (" << n.rxPackets
+                   << " pkt/s) tx " << n.txBytes / (1024.0 * 1024.0) << " MB/s (" << n.txPackets << " pkt/s)" << endl;
+    }
+}
 
-    return true;
+// Container usage against the cgroup's own limits.
+void writeCgroup(stringstream& dataStream, const string& path, const CgroupUsage& c) {
+    dataStream << "Container (" << path << "):" << endl;
+    if (c.haveCpu) {
+        dataStream << "  CPU " << c.cpuCores << " of " << c.cpuLimitCores << " cores (" << c.cpuPercentOfLimit << "% of "
+                   << (c.cpuLimited ? "quota" : "online CPUs") << "), throttled " << c.throttledPercent
+                   << "% of periods, " << c.throttledMsPerSec << " ms/s" << endl;
+    }
+    if (c.haveMemory) {
+        dataStream << "  Memory " << c.memoryBytes / (1024.0 * 1024.0) << " of " << c.memoryLimitBytes / (1024.0 * 1024.0)
+                   << " MB (" << c.memoryPercentOfLimit << "% of " << (c.memoryLimited ? "memory.max" : "host memory")
+                   << ")" << endl;
+    }
+    for (size_t i = 0; i < c.io.size(); ++i) {
+        const CgroupIoRate& d = c.io[i];
+        dataStream << "  I/O " << d.device << " read " << d.readBytes / (1024.0 * 1024.0) << " MB/s (" << d.readOps
+                   << " IOPS) write " << d.writeBytes / (1024.0 * 1024.0) << " MB/s (" << d.writeOps << " IOPS)" << endl;
+    }
+    const char* names[3] = {"CPU", "Memory", "I/O"};
+    const CgroupPressure* pressures[3] = {&c.cpuPressure, &c.memoryPressure, &c.ioPressure};
+    for (int i = 0; i < 3; ++i) {
+        const CgroupPressure& p = *pressures[i];
+        if (!p.present)
+            continue;
+        dataStream << "  " << names[i] << " Pressure: some " << p.some.avg10 << "% / " << p.some.avg60 << "% / "
+                   << p.some.avg300 << "%, full " << p.full.avg10 << "% / " << p.full.avg60 << "% / " << p.full.avg300
+                   << "% (10s / 60s / 300s)" << endl;
+    }
 }
 
-void updateResourceStats(UsageStats& stats, double currentUsage) {
-    stats.currentUsage = currentUsage;
-    if (currentUsage > stats.maxUsage)
-        stats.maxUsage = currentUsage;
-    stats.totalUsage += currentUsage;
-    stats.count++;
+void writeBursts(stringstream& dataStream, chrono::milliseconds interval, const BurstSummary& bursts) {
+    dataStream << "CPU Bursts (" << interval.count() << "ms): avg " << bursts.average << "% min " << bursts.min
+               << "% max " << bursts.max << "% p50 " << bursts.p50 << "% p99 " << bursts.p99 << "% ("
+               << bursts.count << " samples, " << bursts.dropped << " dropped)" << endl;
 }
 
-void writeStatsToFile(const string& filename, const stringstream& dataStream) {
-    static mutex mtx; // Declare a static mutex
+// Which alerts are firing, and the EWMA baseline they are judged against.
+template <typename Core>
+void writeAlerts(stringstream& dataStream, const Core& core, const AlertSink& sink) {
+    dataStream << "Alerts (" << sink.path() << ", " << sink.written() << " events";
+    if (sink.lost())
+        dataStream << ", " << sink.lost() << " lost";
+    dataStream << "):" << endl;
+    core.forEach([&](const char* label, const char*, const MetricState& m) {
+        const AlertDetector& a = m.alerts;
+        dataStream << "  " << label << ": EWMA " << a.mean() << "% stddev " << a.stddev() << "% z " << a.z();
+        if (a.thresholdFiring())
+            dataStream << " [THRESHOLD]";
+        if (a.anomalyFiring())
+            dataStream << " [ANOMALY]";
+        dataStream << endl;
+    });
+}
 
-    // Lock the mutex to ensure exclusive access to the file
-    lock_guard<mutex> lock(mtx);
+void writeSelfOverhead(stringstream& dataStream, const SelfOverhead& overhead) {
+    dataStream << "Monitor CPU: " << overhead.cpuMsPerSecond() << " ms/s (" << overhead.percentOfCore()
+               << "% of a core), since start " << overhead.totalCpuMsPerSecond() << " ms/s ("
+               << overhead.totalPercentOfCore() << "%)" << endl;
+}
 
-    ofstream outfile(filename);
-    if (!outfile.is_open()) {
-        cerr << "Error: Could not open file " << filename << endl;
-        return;
+// Run-time latency of every instrumented stage, in microseconds.
+void writeStageLatencies(stringstream& dataStream) {
+    StageRegistry& registry = stageRegistry();
+    dataStream << "Stage Latency (us):" << endl;
+    for (size_t i = 0; i < registry.stages(); ++i) {
+        StageLatency l = registry.latency(static_cast<int>(i));
+        if (l.calls == 0)
+            continue;
+        dataStream << "  " << registry.name(static_cast<int>(i)) << ": " << l.calls << " runs, avg "
+                   << l.totalNs / 1000.0 / l.calls << " p50 " << l.histogram.quantile(0.50) / 1000.0 << " p99 "
+                   << l.histogram.quantile(0.99) / 1000.0 << " max " << l.maxNs / 1000.0 << endl;
     }
+}
 
-    outfile << dataStream.str(); // Write the contents of the stringstream to the file
+// Prometheus text exposition. Every family gets its HELP/TYPE header once,
+// followed by all of its samples.
+void writeFamily(stringstream& out, const char* name, const char* type, const char* help) {
+    out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+}
 
-    outfile.close();
+void writeSample(stringstream& out, const char* name, const string& labels, double value) {
+    out << name;
+    if (!labels.empty())
+        out << "{" << labels << "}";
+    if (value != value)
+        out << " NaN\n";
+    else
+        out << " " << value << "\n";
 }
 
-void monitorCPU(UsageStats& cpuStats, stringstream& dataStream) {
-    while (true) {
-        double cpu_usage;
-        if (getCPUUsage(cpu_usage)) {
-            updateResourceStats(cpuStats, cpu_usage);
-        }
-        this_thread::sleep_for(chrono::milliseconds(1000));
-    }
+string label(const char* key, const string& value) {
+    return string(key) + "=\"" + value + "\"";
 }
 
-void monitorRAM(UsageStats& ramStats, stringstream& dataStream) {
-    while (true) {
-        double ram_usage;
-        if (getRAMUsage(ram_usage)) {
-            updateResourceStats(ramStats, ram_usage);
-        }
-        this_thread::sleep_for(chrono::milliseconds(1000));
+void writeCgroupExposition(stringstream& out, const string& path, const CgroupUsage& c) {
+    string cgroup = label("cgroup", path);
+    if (c.haveCpu) {
+        writeFamily(out, "resmon_cgroup_cpu_cores", "gauge", "CPUs' worth of time used by the cgroup.");
+        writeSample(out, "resmon_cgroup_cpu_cores", cgroup, c.cpuCores);
+        writeFamily(out, "resmon_cgroup_cpu_limit_cores", "gauge", "cpu.max quota in CPUs, or online CPUs if unlimited.");
+        writeSample(out, "resmon_cgroup_cpu_limit_cores", cgroup, c.cpuLimitCores);
+        writeFamily(out, "resmon_cgroup_cpu_limit_percent", "gauge", "CPU use relative to the limit.");
+        writeSample(out, "resmon_cgroup_cpu_limit_percent", cgroup, c.cpuPercentOfLimit);
+        writeFamily(out, "resmon_cgroup_cpu_throttled_percent", "gauge", "Share of enforcement periods throttled.");
+        writeSample(out, "resmon_cgroup_cpu_throttled_percent", cgroup, c.throttledPercent);
+        writeFamily(out, "resmon_cgroup_cpu_throttled_periods_total", "counter", "Enforcement periods throttled.");
+        writeSample(out, "resmon_cgroup_cpu_throttled_periods_total", cgroup, static_cast<double>(c.throttledPeriods));
+    }
+    if (c.haveMemory) {
+        writeFamily(out, "resmon_cgroup_memory_bytes", "gauge", "memory.current of the cgroup.");
+        writeSample(out, "resmon_cgroup_memory_bytes", cgroup, c.memoryBytes);
+        writeFamily(out, "resmon_cgroup_memory_limit_bytes", "gauge", "memory.max, or host memory if unlimited.");
+        writeSample(out, "resmon_cgroup_memory_limit_bytes", cgroup, c.memoryLimitBytes);
+        writeFamily(out, "resmon_cgroup_memory_limit_percent", "gauge", "Memory use relative to the limit.");
+        writeSample(out, "resmon_cgroup_memory_limit_percent", cgroup, c.memoryPercentOfLimit);
     }
-}
 
-void monitorDisk(UsageStats& diskStats, stringstream& dataStream) {
-    while (true) {
-        double disk_usage;
-        if (getDiskUsage(disk_usage)) {
-            updateResourceStats(diskStats, disk_usage);
+    const struct {
+        const char* name;
+        const char* help;
+        double CgroupIoRate::*field;
+    } ioFields[] = {
+        {"resmon_cgroup_io_read_bytes_per_second", "Bytes read per second by the cgroup.", &CgroupIoRate::readBytes},
+        {"resmon_cgroup_io_write_bytes_per_second", "Bytes written per second by the cgroup.", &CgroupIoRate::writeBytes},
+        {"resmon_cgroup_io_reads_per_second", "Reads per second by the cgroup.", &CgroupIoRate::readOps},
+        {"resmon_cgroup_io_writes_per_second", "Writes per second by the cgroup.", &CgroupIoRate::writeOps},
+    };
+    for (size_t f = 0; c.haveIo && f < sizeof(ioFields) / sizeof(ioFields[0]); ++f) {
+        writeFamily(out, ioFields[f].name, "gauge", ioFields[f].help);
+        for (size_t i = 0; i < c.io.size(); ++i)
+            writeSample(out, ioFields[f].name, cgroup + "," + label("device", c.io[i].device), c.io[i].*ioFields[f].field);
+    }
+
+    const char* resources[3] = {"cpu", "memory", "io"};
+    const CgroupPressure* pressures[3] = {&c.cpuPressure, &c.memoryPressure, &c.ioPressure};
+    writeFamily(out, "resmon_cgroup_pressure_percent", "gauge", "PSI stall share over a window.");
+    for (int i = 0; i < 3; ++i) {
+        if (!pressures[i]->present)
+            continue;
+        const PressureAverages* kinds[2] = {&pressures[i]->some, &pressures[i]->full};
+        const char* kindNames[2] = {"some", "full"};
+        for (int k = 0; k < 2; ++k) {
+            string labels = cgroup + "," + label("resource", resources[i]) + "," + label("kind", kindNames[k]);
+            writeSample(out, "resmon_cgroup_pressure_percent", labels + "," + label("window", "10s"), kinds[k]->avg10);
+            writeSample(out, "resmon_cgroup_pressure_percent", labels + "," + label("window", "60s"), kinds[k]->avg60);
+            writeSample(out, "resmon_cgroup_pressure_percent", labels + "," + label("window", "300s"), kinds[k]->avg300);
         }
-        this_thread::sleep_for(chrono::milliseconds(1000));
     }
 }
 
-string formatTime(long long seconds) {
-    long long hours = seconds / 3600;
-    long long minutes = (seconds % 3600) / 60;
-    long long secs = seconds % 60;
-
-    stringstream ss;
-    if (hours > 0) {
-        ss << hours << "h ";
+template <typename Core>
+void writeExposition(stringstream& out, const Core& core, const vector<DiskRate>& disks,
+                     const vector<NetRate>& interfaces, const CgroupSampler* cgroup, const CgroupUsage& container,
+                     const SelfOverhead& overhead) {
+    writeFamily(out, "resmon_usage_percent", "gauge", "Latest usage sample.");
+    core.forEach([&](const char*, const char* key, const MetricState& m) {
+        writeSample(out, "resmon_usage_percent", label("resource", key), m.stats.currentUsage);
+    });
+    writeFamily(out, "resmon_usage_max_percent", "gauge", "Highest usage since start.");
+    core.forEach([&](const char*, const char* key, const MetricState& m) {
+        writeSample(out, "resmon_usage_max_percent", label("resource", key), m.stats.maxUsage);
+    });
+    writeFamily(out, "resmon_usage_average_percent", "gauge", "Average usage since start.");
+    core.forEach([&](const char*, const char* key, const MetricState& m) {
+        writeSample(out, "resmon_usage_average_percent", label("resource", key),
+                    m.stats.count ? m.stats.totalUsage / m.stats.count : 0.0 / 0.0);
+    });
+
+    const char* windowNames[3] = {"1m", "5m", "15m"};
+    writeFamily(out, "resmon_usage_window_average_percent", "gauge", "Average usage over a sliding window.");
+    core.forEach([&](const char*, const char* key, const MetricState& m) {
+        const size_t ids[3] = {m.windows.oneMinute, m.windows.fiveMinutes, m.windows.fifteenMinutes};
+        for (int k = 0; k < 3; ++k)
+            writeSample(out, "resmon_usage_window_average_percent",
+                        label("resource", key) + "," + label("window", windowNames[k]),
+                        m.windows.history.summary(ids[k]).average);
+    });
+
+    const char* quantiles[4] = {"0.5", "0.95", "0.99", "0.999"};
+    const double qs[4] = {0.50, 0.95, 0.99, 0.999};
+    writeFamily(out, "resmon_usage_quantile_percent", "gauge", "Usage percentile since start.");
+    core.forEach([&](const char*, const char* key, const MetricState& m) {
+        for (int k = 0; k < 4; ++k)
+            writeSample(out, "resmon_usage_quantile_percent",
+                        label("resource", key) + "," + label("quantile", quantiles[k]), m.percentiles.percentile(qs[k]));
+    });
+
+    writeFamily(out, "resmon_usage_ewma_percent", "gauge", "Exponentially weighted mean usage (alert baseline).");
+    core.forEach([&](const char*, const char* key, const MetricState& m) {
+        writeSample(out, "resmon_usage_ewma_percent", label("resource", key), m.alerts.mean());
+    });
+    writeFamily(out, "resmon_alert_firing", "gauge", "1 while an alert is firing.");
+    core.forEach([&](const char*, const char* key, const MetricState& m) {
+        writeSample(out, "resmon_alert_firing", label("resource", key) + "," + label("kind", "threshold"),
+                    m.alerts.thresholdFiring() ? 1.0 : 0.0);
+        writeSample(out, "resmon_alert_firing", label("resource", key) + "," + label("kind", "anomaly"),
+                    m.alerts.anomalyFiring() ? 1.0 : 0.0);
+    });
+
+    const struct {
+        const char* name;
+        const char* help;
+        double DiskRate::*field;
+    } diskFields[] = {
+        {"resmon_disk_read_bytes_per_second", "Bytes read per second.", &DiskRate::readBytes},
+        {"resmon_disk_write_bytes_per_second", "Bytes written per second.", &DiskRate::writeBytes},
+        {"resmon_disk_reads_per_second", "Completed reads per second.", &DiskRate::readOps},
+        {"resmon_disk_writes_per_second", "Completed writes per second.", &DiskRate::writeOps},
+        {"resmon_disk_await_milliseconds", "Average time per completed I/O.", &DiskRate::awaitMs},
+        {"resmon_disk_utilization_percent", "Share of time with I/O in flight.", &DiskRate::util},
+        {"resmon_disk_queue_depth", "Average number of I/Os in flight.", &DiskRate::queueDepth},
+    };
+    for (size_t f = 0; f < sizeof(diskFields) / sizeof(diskFields[0]); ++f) {
+        writeFamily(out, diskFields[f].name, "gauge", diskFields[f].help);
+        for (size_t i = 0; i < disks.size(); ++i)
+            writeSample(out, diskFields[f].name, label("device", disks[i].name), disks[i].*diskFields[f].field);
     }
-    if (minutes > 0) {
-        ss << minutes << "m ";
+
+    const struct {
+        const char* name;
+        const char* help;
+        double NetRate::*field;
+    } netFields[] = {
+        {"resmon_network_receive_bytes_per_second", "Bytes received per second.", &NetRate::rxBytes},
+        {"resmon_network_transmit_bytes_per_second", "Bytes sent per second.", &NetRate::txBytes},
+        {"resmon_network_receive_packets_per_second", "Packets received per second.", &NetRate::rxPackets},
+        {"resmon_network_transmit_packets_per_second", "Packets sent per second.", &NetRate::txPackets},
+    };
+    for (size_t f = 0; f < sizeof(netFields) / sizeof(netFields[0]); ++f) {
+        writeFamily(out, netFields[f].name, "gauge", netFields[f].help);
+        for (size_t i = 0; i < interfaces.size(); ++i)
+            writeSample(out, netFields[f].name, label("interface", interfaces[i].name),
+                        interfaces[i].*netFields[f].field);
     }
-    ss << secs << "s";
 
-    return ss.str();
+    if (cgroup)
+        writeCgroupExposition(out, cgroup->path(), container);
+
+    writeFamily(out, "resmon_monitor_cpu_seconds_total", "counter", "CPU time used by the monitor itself.");
+    writeSample(out, "resmon_monitor_cpu_seconds_total", "", overhead.cpuSeconds());
+    writeFamily(out, "resmon_monitor_cpu_percent_of_core", "gauge", "Monitor CPU time over the last report interval.");
+    writeSample(out, "resmon_monitor_cpu_percent_of_core", "", overhead.percentOfCore());
+
+    StageRegistry& registry = stageRegistry();
+    writeFamily(out, "resmon_stage_latency_seconds", "summary", "Run time of the monitor's own stages.");
+    for (size_t i = 0; i < registry.stages(); ++i) {
+        StageLatency l = registry.latency(static_cast<int>(i));
+        string stage = label("stage", registry.name(static_cast<int>(i)));
+        writeSample(out, "resmon_stage_latency_seconds", stage + "," + label("quantile", "0.5"),
+                    l.histogram.quantile(0.50) / 1e9);
+        writeSample(out, "resmon_stage_latency_seconds", stage + "," + label("quantile", "0.99"),
+                    l.histogram.quantile(0.99) / 1e9);
+        writeSample(out, "resmon_stage_latency_seconds_sum", stage, l.totalNs / 1e9);
+        writeSample(out, "resmon_stage_latency_seconds_count", stage, static_cast<double>(l.calls));
+    }
 }
 
-string getCurrentTimestamp() {
-    char buffer[80];
-    time_t rawtime;
-    struct tm timeinfo;
-
-    time(&rawtime);
-    localtime_s(&timeinfo, &rawtime);
-
-    strftime(buffer, sizeof(buffer), "%I:%M:%S %p", &timeinfo);
-    string time_str(buffer);
+int main(int argc, char* argv[]) {
+    string filename = "resource_usage.txt";
+    stringstream dataStream;
 
-    strftime(buffer, sizeof(buffer), "%A, %d %B %Y (%Z)", &timeinfo);
-    string date_location_str(buffer);
+    // One --<key>-interval option per collector.
+    typedef MonitorCore<CpuCollector, RamCollector, DiskCollector> Core;
+    chrono::milliseconds intervals[Core::kMetrics];
+    for (size_t i = 0; i < Core::kMetrics; ++i)
+        intervals[i] = intervalOption(argc, argv, string("--") + Core::key(i) + "-interval", chrono::milliseconds(1000));
+    chrono::milliseconds reportInterval = intervalOption(argc, argv, "--report-interval", chrono::milliseconds(1000));
+    chrono::milliseconds processInterval = intervalOption(argc, argv, "--process-interval", chrono::milliseconds(1000));
+    chrono::milliseconds ioInterval = intervalOption(argc, argv, "--io-interval", chrono::milliseconds(1000));
+    // High-frequency CPU sampling is off unless an interval is given.
+    chrono::milliseconds fastInterval = intervalOption(argc, argv, "--fast-interval", chrono::milliseconds(0));
+    int topN = atoi(stringOption(argc, argv, "--top", "5").c_str());
+    string logPath = stringOption(argc, argv, "--log", "resource_usage.bin");
+    int httpPort = atoi(stringOption(argc, argv, "--http-port", "0").c_str());
+    // Streams every report-tick sample to an aggregator (resaggregator).
+    string agentAddress = stringOption(argc, argv, "--agent", "");
+    string agentName = stringOption(argc, argv, "--agent-name", "");
+    int agentBatch = atoi(stringOption(argc, argv, "--agent-batch", "5").c_str());
+    // Records every raw /proc and /sys read for collector_bench to replay.
+    string capturePath = stringOption(argc, argv, "--capture", "");
+    // Alert transitions go to their own log, not the report.
+    string alertLogPath = stringOption(argc, argv, "--alert-log", "alerts.log");
+    ConfigureAlerts alertOptions = {argc, argv, AlertConfig()};
+    alertOptions.defaults.fireZ = doubleOption(argc, argv, "--alert-z", alertOptions.defaults.fireZ);
+    // Anomalies clear at half the firing z-score (2 for the default 4).
+    alertOptions.defaults.clearZ = alertOptions.defaults.fireZ / 2;
+    alertOptions.defaults.hysteresis = doubleOption(argc, argv, "--alert-hysteresis", alertOptions.defaults.hysteresis);
+    alertOptions.defaults.alpha = doubleOption(argc, argv, "--alert-alpha", alertOptions.defaults.alpha);
+    if (alertOptions.defaults.alpha <= 0.0 || alertOptions.defaults.alpha > 1.0) {
+        cerr << "Error: --alert-alpha must be in (0, 1]." << endl;
+        return 1;
+    }
+    // Container stats for this process's cgroup, a named one, or "off".
+    string cgroupName = stringOption(argc, argv, "--cgroup", "");
+    chrono::milliseconds cgroupInterval = intervalOption(argc, argv, "--cgroup-interval", chrono::milliseconds(1000));
+
+    // Installed before any collector opens its files.
+    ProcTap captureTap;
+    if (!capturePath.empty()) {
+        if (!captureTap.capture(capturePath.c_str())) {
+            cerr << "Error: Could not open capture file " << capturePath << endl;
+            return 1;
+        }
+        procTap() = &captureTap;
+    }
 
-    return time_str + "\n" + date_location_str + "\n";
-}
+    // Reports are rendered here and written by a background thread.
+    ReportWriter reportWriter(filename);
 
-int main() {
-    string filename = "resource_usage.txt";
-    stringstream dataStream;
+    // Optional /metrics endpoint on localhost, refreshed every report tick.
+    MetricsServer metricsServer;
+    stringstream metricsStream;
+    if (httpPort > 0 && (httpPort > 65535 || !metricsServer.start(static_cast<unsigned short>(httpPort)))) {
+        cerr << "Error: Unable to start metrics endpoint on port " << httpPort << "." << endl;
+        return 1;
+    }
 
-    UsageStats cpuStats = {0.0, 0.0, 0.0, 0};
-    UsageStats ramStats = {0.0, 0.0, 0.0, 0};
-    UsageStats diskStats = {0.0, 0.0, 0.0, 0};
+    // Agent mode: batched frames to the aggregator, sent from the report tick.
+    if (agentName.empty()) {
+        char hostname[256] = "";
+        gethostname(hostname, sizeof(hostname) - 1);
+        agentName = hostname;
+    }
+    if (agentBatch < 1 || static_cast<size_t>(agentBatch) > AgentStream::maxBatch(agentName)) {
+        cerr << "Error: --agent-batch must be between 1 and " << AgentStream::maxBatch(agentName) << "." << endl;
+        return 1;
+    }
+    AgentStream agent(agentName, reportInterval, static_cast<size_t>(agentBatch));
+    if (!agentAddress.empty() && !agent.start(agentAddress))
+        return 1;
+
+    // Binary history of every report tick; the text file only holds the
+    // latest report.
+    SampleLogWriter sampleLog;
+    if (!sampleLog.open(logPath))
+        cerr << "Error: Sample history will not be recorded." << endl;
+
+    // The collectors are the only writers of their snapshots; readers get a
+    // consistent copy without blocking the samplers.
+    Core core(intervals);
+    core.visit(alertOptions);
+    // Alert lines are formatted on the report tick and appended to the log
+    // by a background thread, so the sampling thread never touches the disk.
+    AlertSink alertSink(alertLogPath, false);
+    LogAppender alertLog(alertLogPath, "alert-write");
 
     auto startTime = chrono::steady_clock::now();
+    SelfOverhead selfOverhead;
+
+    // Every collector and the report run from this one thread.
+    SampleScheduler scheduler;
+    ScheduleCollectors collectors = {scheduler, vector<int>()};
+    core.visit(collectors);
+    bool scheduled = true;
+    for (size_t i = 0; i < collectors.tasks.size(); ++i)
+        scheduled = scheduled && collectors.tasks[i] >= 0;
+    // Per-process top-N; --top 0 turns the process scan off.
+    ProcessTable processTable(topN > 0 ? static_cast<size_t>(topN) : 0);
+    int processTask = 0;
+    if (topN > 0)
+        processTask = scheduler.add("processes", processInterval, [&] { processTable.scan(); });
+    // Block device and network interface throughput.
+    DiskStatsSampler diskStats;
+    NetDevSampler netDev;
+    vector<DiskRate> diskRates;
+    vector<NetRate> netRates;
+    int diskIoTask = scheduler.add("diskio", ioInterval, [&] { diskStats.sample(diskRates); });
+    int netTask = scheduler.add("net", ioInterval, [&] { netDev.sample(netRates); });
+    // cgroup v2 usage and limits. Without a cgroup2 hierarchy the section
+    // is left out, unless a cgroup was asked for by name.
+    unique_ptr<CgroupSampler> cgroup;
+    CgroupUsage container = CgroupUsage();
+    int cgroupTask = 0;
+    if (cgroupName != "off") {
+        string dir = findCgroup(cgroupName);
+        if (!dir.empty()) {
+            cgroup.reset(new CgroupSampler(dir));
+            cgroupTask = scheduler.add("cgroup", cgroupInterval, [&] { cgroup->sample(container); });
+        } else if (!cgroupName.empty()) {
+            cerr << "Error: cgroup " << cgroupName << " not found under the cgroup v2 hierarchy." << endl;
+            return 1;
+        }
+    }
+    // Sub-second CPU samples, buffered for one report interval at a time.
+    BurstSampler bursts(fastInterval.count() > 0 ? 2 * static_cast<size_t>(reportInterval / fastInterval) + 16 : 0);
+    int fastTask = 0;
+    if (fastInterval.count() > 0)
+        fastTask = scheduler.add("fast-cpu", fastInterval, [&] { bursts.sample(); });
+    if (!scheduled || processTask < 0 || diskIoTask < 0 || netTask < 0 || fastTask < 0 || cgroupTask < 0) {
+        cerr << "Error: Unable to schedule collectors." << endl;
+        return 1;
+    }
 
-    thread cpuThread(monitorCPU, ref(cpuStats), ref(dataStream));
-    thread ramThread(monitorRAM, ref(ramStats), ref(dataStream));
-    thread diskThread(monitorDisk, ref(diskStats), ref(dataStream));
-
-    while (true) {
+    int reportTask = scheduler.add("report", reportInterval, [&] {
         // Clear the stringstream
         dataStream.str("");
 
@@ -186,31 +542,79 @@ int main() {
         auto elapsedTimeSeconds = chrono::duration_cast<chrono::seconds>(currentTime - startTime).count();
         string elapsedTimeFormatted = formatTime(elapsedTimeSeconds);
 
+        SampleRecord record = {realtimeNs(), core.metric<CpuCollector>().snapshot.load().currentUsage,
+                               core.metric<RamCollector>().snapshot.load().currentUsage,
+                               core.metric<DiskCollector>().snapshot.load().currentUsage};
+        sampleLog.append(record);
+        if (!agentAddress.empty())
+            agent.push(record);
+
         dataStream << "LIVE RESMON :->" << endl;
         dataStream << "Timestamp: " << getCurrentTimestamp() << endl;
         dataStream << "Running Time: " << elapsedTimeFormatted << endl << "\n";
-        dataStream << "Current CPU Usage: " << cpuStats.currentUsage << "%" << endl;
-        dataStream << "Max CPU Usage: " << cpuStats.maxUsage << "%" << endl;
-        dataStream << "Average CPU Usage: " << (cpuStats.totalUsage / cpuStats.count) << "%" << endl;
+        writeUsageSummary(dataStream, core);
+        dataStream << "--------------------------------------" << endl;
+        core.forEach([&](const char* label, const char*, const MetricState& m) {
+            writeWindows(dataStream, label, m.windows);
+        });
         dataStream << "--------------------------------------" << endl;
-        dataStream << "Current RAM Usage: " << ramStats.currentUsage << "%" << endl;
-        dataStream << "Max RAM Usage: " << ramStats.maxUsage << "%" << endl;
-        dataStream << "Average RAM Usage: " << (ramStats.totalUsage / ramStats.count) << "%" << endl;
+        core.forEach([&](const char* label, const char*, const MetricState& m) {
+            writePercentiles(dataStream, label, m.percentiles);
+        });
+        if (fastInterval.count() > 0)
+            writeBursts(dataStream, fastInterval, bursts.drain());
         dataStream << "--------------------------------------" << endl;
-        dataStream << "Current Disk Usage: " << diskStats.currentUsage << "%" << endl;
-        dataStream << "Max Disk Usage: " << diskStats.maxUsage << "%" << endl;
-        dataStream << "Average Disk Usage: " << (diskStats.totalUsage / diskStats.count) << "%" << endl;
+        writeDiskRates(dataStream, diskRates);
+        writeNetRates(dataStream, netRates);
+        if (cgroup) {
+            dataStream << "--------------------------------------" << endl;
+            writeCgroup(dataStream, cgroup->path(), container);
+        }
+        if (topN > 0) {
+            dataStream << "--------------------------------------" << endl;
+            dataStream << "Processes: " << processTable.processes() << endl;
+            writeTopProcesses(dataStream, "Top CPU", processTable.topCpu());
+            writeTopProcesses(dataStream, "Top RSS", processTable.topRss());
+        }
+        dataStream << "--------------------------------------" << endl;
+        dataStream << "Missed Ticks:";
+        for (size_t i = 0; i < collectors.tasks.size(); ++i)
+            dataStream << (i ? ", " : " ") << Core::label(i) << " " << scheduler.task(collectors.tasks[i]).missed;
+        if (fastInterval.count() > 0)
+            dataStream << ", Fast CPU " << scheduler.task(fastTask).missed;
+        dataStream << endl;
+        string alertLines;
+        alertSink.collect(core, alertLines);
+        alertLog.append(alertLines);
+        writeAlerts(dataStream, core, alertSink);
+        selfOverhead.sample();
+        writeSelfOverhead(dataStream, selfOverhead);
+        writeStageLatencies(dataStream);
+
+        if (!agentAddress.empty()) {
+            dataStream << "Agent: " << agentName << " -> " << agentAddress << (agent.connected() ? "" : " (disconnected)")
+                       << ", " << agent.samplesSent() << " samples in " << agent.frames() << " frames, "
+                       << agent.samplesDropped() << " dropped" << endl;
+        }
+        dataStream << "Report Writes: " << reportWriter.written() << " (coalesced " << reportWriter.coalesced()
+                   << ", failed " << reportWriter.failed() << ")" << endl;
 
-        // Write the contents of the stringstream to the file
-        writeStatsToFile(filename, dataStream);
+        if (!capturePath.empty())
+            captureTap.flush();
 
-        // Sleep for a short duration
-        this_thread::sleep_for(chrono::milliseconds(1000));
-    }
+        // Hand the report to the writer thread
+        reportWriter.submit(dataStream.str());
 
-    cpuThread.join();
-    ramThread.join();
-    diskThread.join();
+        if (httpPort > 0) {
+            metricsStream.str("");
+            writeExposition(metricsStream, core, diskRates, netRates, cgroup.get(), container, selfOverhead);
+            metricsServer.publish(metricsStream.str());
+        }
+    });
+    if (reportTask < 0) {
+        cerr << "Error: Unable to schedule report." << endl;
+        return 1;
+    }
 
-    return 0;
+    return scheduler.run() ? 0 : 1;
 }
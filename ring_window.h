@@ -0,0 +1,166 @@
+#ifndef RING_WINDOW_H
+#define RING_WINDOW_H
+
+// Fixed-capacity sample history with sliding-window statistics.
+// One ring buffer holds the last N samples of a metric; each window over
+// the last n <= N samples keeps a running sum for the average and two
+// monotonic deques for min/max, so a push costs O(1) amortized per window
+// and memory never grows after construction.
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+struct WindowSummary {
+    size_t count;
+    double average;
+    double min;
+    double max;
+};
+
+class MetricHistory {
+public:
+    explicit MetricHistory(size_t capacity)
+        : ring_(capacity > 0 ? capacity : 1), pushed_(0) {}
+
+    size_t capacity() const { return ring_.size(); }
+    size_t size() const { return pushed_ < ring_.size() ? static_cast<size_t>(pushed_) : ring_.size(); }
+
+    // Adds a window over the last `samples` samples (clamped to capacity)
+    // and returns its index. Windows added after samples were pushed start
+    // empty.
+    size_t addWindow(size_t samples) {
+        if (samples == 0)
+            samples = 1;
+        if (samples > ring_.size())
+            samples = ring_.size();
+        windows_.push_back(Window(samples));
+        return windows_.size() - 1;
+    }
+
+    void push(double value) {
+        unsigned long long seq = pushed_++;
+        // Evict before the slot is overwritten: a window as long as the
+        // ring drops exactly the sample being replaced.
+        for (size_t i = 0; i < windows_.size(); ++i)
+            windows_[i].evict(seq, *this);
+        ring_[seq % ring_.size()] = value;
+        for (size_t i = 0; i < windows_.size(); ++i)
+            windows_[i].push(seq, value, *this);
+    }
+
+    // Sample `ago` steps back from the newest (0 = newest). ago < size().
+    double recent(size_t ago) const { return ring_[(pushed_ - 1 - ago) % ring_.size()]; }
+
+    WindowSummary summary(size_t window) const {
+        const Window& w = windows_[window];
+        WindowSummary s = {w.count, 0.0, 0.0, 0.0};
+        if (w.count > 0) {
+            s.average = w.sum / w.count;
+            s.min = w.minq.front().value;
+            s.max = w.maxq.front().value;
+        }
+        return s;
+    }
+
+private:
+    struct Entry {
+        unsigned long long seq;
+        double value;
+    };
+
+    // Deque of at most `capacity` entries in a fixed ring.
+    class MonoDeque {
+    public:
+        explicit MonoDeque(size_t capacity) : buf_(capacity), head_(0), size_(0) {}
+
+        bool empty() const { return size_ == 0; }
+        const Entry& front() const { return buf_[head_]; }
+        const Entry& back() const { return buf_[(head_ + size_ - 1) % buf_.size()]; }
+        void popFront() {
+            head_ = (head_ + 1) % buf_.size();
+            --size_;
+        }
+        void popBack() { --size_; }
+        void pushBack(const Entry& e) {
+            buf_[(head_ + size_) % buf_.size()] = e;
+            ++size_;
+        }
+
+    private:
+        std::vector<Entry> buf_;
+        size_t head_;
+        size_t size_;
+    };
+
+    struct Window {
+        size_t length;
+        size_t count;
+        double sum;
+        size_t sinceResum;
+        MonoDeque minq;
+        MonoDeque maxq;
+
+        explicit Window(size_t n) : length(n), count(0), sum(0.0), sinceResum(0), minq(n), maxq(n) {}
+
+        void evict(unsigned long long seq, const MetricHistory& history) {
+            if (count == length)
+                sum -= history.ring_[(seq - length) % history.ring_.size()];
+            else
+                ++count;
+        }
+
+        void push(unsigned long long seq, double value, const MetricHistory& history) {
+            sum += value;
+
+            // Add/subtract drift is bounded by re-summing once per window
+            // length, which keeps the cost O(1) amortized.
+            if (++sinceResum >= length) {
+                sinceResum = 0;
+                sum = 0.0;
+                for (size_t i = 0; i < count; ++i)
+                    sum += history.ring_[(seq - i) % history.ring_.size()];
+            }
+
+            if (!minq.empty() && minq.front().seq + length <= seq)
+                minq.popFront();
+            if (!maxq.empty() && maxq.front().seq + length <= seq)
+                maxq.popFront();
+            while (!minq.empty() && minq.back().value >= value)
+                minq.popBack();
+            while (!maxq.empty() && maxq.back().value <= value)
+                maxq.popBack();
+            Entry e = {seq, value};
+            minq.pushBack(e);
+            maxq.pushBack(e);
+        }
+    };
+
+    std::vector<double> ring_;
+    unsigned long long pushed_;
+    std::vector<Window> windows_;
+};
+
+// 1m/5m/15m windows, load-average style, for a metric sampled every
+// `interval`.
+struct LoadWindows {
+    MetricHistory history;
+    size_t oneMinute;
+    size_t fiveMinutes;
+    size_t fifteenMinutes;
+
+    explicit LoadWindows(std::chrono::milliseconds interval)
+        : history(samplesIn(std::chrono::minutes(15), interval)),
+          oneMinute(history.addWindow(samplesIn(std::chrono::minutes(1), interval))),
+          fiveMinutes(history.addWindow(samplesIn(std::chrono::minutes(5), interval))),
+          fifteenMinutes(history.addWindow(samplesIn(std::chrono::minutes(15), interval))) {}
+
+    void push(double value) { history.push(value); }
+
+    static size_t samplesIn(std::chrono::milliseconds span, std::chrono::milliseconds interval) {
+        long long n = interval.count() > 0 ? span.count() / interval.count() : 1;
+        return n > 0 ? static_cast<size_t>(n) : 1;
+    }
+};
+
+#endif
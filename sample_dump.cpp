@@ -0,0 +1,44 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+
+#include "sample_log.h"
+
+using namespace std;
+
+// Prints the records of a resmonitoring binary sample log as CSV.
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <resource_usage.bin> [--last N]" << endl;
+        return 1;
+    }
+
+    size_t last = 0;
+    for (int i = 2; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--last") == 0)
+            last = static_cast<size_t>(atoll(argv[i + 1]));
+    }
+
+    SampleLogReader log;
+    if (!log.open(argv[1])) {
+        cerr << "Error: Could not read sample log " << argv[1] << endl;
+        return 1;
+    }
+
+    size_t first = (last > 0 && last < log.size()) ? log.size() - last : 0;
+    printf("timestamp,cpu,ram,disk\n");
+    for (size_t i = first; i < log.size(); ++i) {
+        const SampleRecord& r = log[i];
+        time_t seconds = static_cast<time_t>(r.timestampNs / 1000000000LL);
+        struct tm timeinfo;
+        localtime_r(&seconds, &timeinfo);
+        char time_buffer[32];
+        strftime(time_buffer, sizeof(time_buffer), "%Y-%m-%d %H:%M:%S", &timeinfo);
+        printf("%s.%03d,%.3f,%.3f,%.3f\n", time_buffer, static_cast<int>((r.timestampNs / 1000000) % 1000), r.cpu,
+               r.ram, r.disk);
+    }
+    return 0;
+}
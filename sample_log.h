@@ -0,0 +1,269 @@
+#ifndef SAMPLE_LOG_H
+#define SAMPLE_LOG_H
+
+// Append-only binary time series of fixed 32-byte records.
+//
+// The file starts with a 32-byte header followed by records. The writer
+// pre-extends the file one segment at a time and appends through a shared
+// mapping of the current segment, so an append is a few stores with no
+// syscalls. A record's timestamp is stored last and a zero timestamp marks
+// unused space, so a crash mid-append loses at most that record; readers stop
+// at the first zero timestamp. A clean close trims the unused tail.
+//
+// A file has one writer at a time: open() takes an exclusive flock and
+// fails if another writer holds it, since two writers would each append
+// from their own idea of the end and trim the other's records on close.
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct SampleRecord {
+    int64_t timestampNs; // CLOCK_REALTIME, nanoseconds since the epoch
+    double cpu;
+    double ram;
+    double disk;
+};
+
+struct SampleLogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint8_t reserved[16];
+};
+
+static_assert(sizeof(SampleRecord) == 32, "SampleRecord must stay 32 bytes");
+static_assert(sizeof(SampleLogHeader) == sizeof(SampleRecord), "header occupies one record slot");
+
+const char kSampleLogMagic[8] = {'R', 'E', 'S', 'M', 'L', 'O', 'G', '\0'};
+const uint32_t kSampleLogVersion = 1;
+
+inline int64_t realtimeNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+inline bool validSampleLogHeader(const SampleLogHeader& h) {
+    return std::memcmp(h.magic, kSampleLogMagic, sizeof(h.magic)) == 0 && h.version == kSampleLogVersion &&
+           h.recordSize == sizeof(SampleRecord);
+}
+
+// Number of committed records in a mapped file image: they form a prefix,
+// so the boundary is found by binary search on the timestamp.
+inline size_t committedRecords(const SampleRecord* records, size_t slots) {
+    size_t lo = 0, hi = slots;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (records[mid].timestampNs != 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+class SampleLogWriter {
+public:
+    // 1 MiB: a multiple of the page size and of the record size.
+    static const size_t kSegmentSize = 1 << 20;
+
+    SampleLogWriter() : fd_(-1), segment_(nullptr), segmentIndex_(0), next_(0) {}
+    ~SampleLogWriter() { close(); }
+
+    SampleLogWriter(const SampleLogWriter&) = delete;
+    SampleLogWriter& operator=(const SampleLogWriter&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            std::cerr << "Error: Could not open sample log " << path << std::endl;
+            return false;
+        }
+        if (flock(fd_, LOCK_EX | LOCK_NB) != 0) {
+            std::cerr << "Error: Sample log " << path << " is in use by another monitor." << std::endl;
+            close();
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd_, &st) != 0) {
+            close();
+            return false;
+        }
+
+        size_t size = static_cast<size_t>(st.st_size);
+        if (size < sizeof(SampleLogHeader)) {
+            SampleLogHeader header;
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, kSampleLogMagic, sizeof(header.magic));
+            header.version = kSampleLogVersion;
+            header.recordSize = sizeof(SampleRecord);
+            if (ftruncate(fd_, 0) != 0 || pwrite(fd_, &header, sizeof(header), 0) != sizeof(header)) {
+                close();
+                return false;
+            }
+            size = sizeof(header);
+        }
+
+        // Find the first free slot. The file may still carry a zeroed tail
+        // from a segment that was pre-extended before a crash.
+        void* image = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd_, 0);
+        if (image == MAP_FAILED) {
+            close();
+            return false;
+        }
+        const SampleLogHeader* header = static_cast<const SampleLogHeader*>(image);
+        bool valid = validSampleLogHeader(*header);
+        size_t slots = size / sizeof(SampleRecord) - 1;
+        size_t used = valid ? committedRecords(reinterpret_cast<const SampleRecord*>(header + 1), slots) : 0;
+        munmap(image, size);
+        if (!valid) {
+            std::cerr << "Error: " << path << " is not a sample log." << std::endl;
+            close();
+            return false;
+        }
+
+        next_ = used + 1; // slot 0 is the header
+        if (!mapSegment(next_ * sizeof(SampleRecord) / kSegmentSize)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    bool append(const SampleRecord& record) {
+        if (fd_ < 0)
+            return false;
+        size_t offset = next_ * sizeof(SampleRecord);
+        size_t segment = offset / kSegmentSize;
+        // segment_ is null after a failed remap; try again rather than
+        // writing through it.
+        if ((!segment_ || segment != segmentIndex_) && !mapSegment(segment))
+            return false;
+
+        SampleRecord* slot = reinterpret_cast<SampleRecord*>(segment_ + (offset - segment * kSegmentSize));
+        slot->cpu = record.cpu;
+        slot->ram = record.ram;
+        slot->disk = record.disk;
+        __atomic_store_n(&slot->timestampNs, record.timestampNs != 0 ? record.timestampNs : 1, __ATOMIC_RELEASE);
+        ++next_;
+        return true;
+    }
+
+    size_t records() const { return next_ > 0 ? next_ - 1 : 0; }
+
+    // Trims the pre-extended tail so the file ends at the last record.
+    void close() {
+        if (segment_) {
+            munmap(segment_, kSegmentSize);
+            segment_ = nullptr;
+        }
+        if (fd_ >= 0) {
+            // next_ is 0 when open() failed before reading the file; leave
+            // it as found.
+            if (next_ > 0 && ftruncate(fd_, static_cast<off_t>(next_ * sizeof(SampleRecord))) != 0)
+                std::cerr << "Error: Could not trim sample log." << std::endl;
+            ::close(fd_);
+            fd_ = -1;
+        }
+        next_ = 0;
+    }
+
+private:
+    bool mapSegment(size_t segment) {
+        if (segment_) {
+            munmap(segment_, kSegmentSize);
+            segment_ = nullptr;
+        }
+
+        off_t end = static_cast<off_t>((segment + 1) * kSegmentSize);
+        struct stat st;
+        if (fstat(fd_, &st) != 0)
+            return false;
+        if (st.st_size < end && ftruncate(fd_, end) != 0) {
+            std::cerr << "Error: Could not extend sample log." << std::endl;
+            return false;
+        }
+
+        void* p = mmap(nullptr, kSegmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd_,
+                       static_cast<off_t>(segment * kSegmentSize));
+        if (p == MAP_FAILED) {
+            std::cerr << "Error: Could not map sample log." << std::endl;
+            return false;
+        }
+        segment_ = static_cast<char*>(p);
+        segmentIndex_ = segment;
+        return true;
+    }
+
+    int fd_;
+    char* segment_;
+    size_t segmentIndex_;
+    size_t next_; // next free slot, counting the header as slot 0
+};
+
+// Read-only view of a whole log file.
+class SampleLogReader {
+public:
+    SampleLogReader() : image_(nullptr), size_(0), records_(nullptr), count_(0) {}
+    ~SampleLogReader() { close(); }
+
+    SampleLogReader(const SampleLogReader&) = delete;
+    SampleLogReader& operator=(const SampleLogReader&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SampleLogHeader)) {
+            ::close(fd);
+            return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+            return false;
+        image_ = p;
+
+        const SampleLogHeader* header = static_cast<const SampleLogHeader*>(image_);
+        if (!validSampleLogHeader(*header)) {
+            close();
+            return false;
+        }
+        records_ = reinterpret_cast<const SampleRecord*>(header + 1);
+        count_ = committedRecords(records_, size_ / sizeof(SampleRecord) - 1);
+        return true;
+    }
+
+    void close() {
+        if (image_)
+            munmap(image_, size_);
+        image_ = nullptr;
+        size_ = 0;
+        records_ = nullptr;
+        count_ = 0;
+    }
+
+    size_t size() const { return count_; }
+    const SampleRecord& operator[](size_t i) const { return records_[i]; }
+
+private:
+    void* image_;
+    size_t size_;
+    const SampleRecord* records_;
+    size_t count_;
+};
+
+#endif
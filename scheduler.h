@@ -0,0 +1,137 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+// Runs every sampling task from one epoll loop. Each task has its own
+// timerfd armed on absolute CLOCK_MONOTONIC deadlines from a shared epoch,
+// so intervals never drift and tasks with related periods stay in phase.
+// If a task overruns or the loop is delayed, the timer's expiration count
+// tells us how many ticks were skipped; those are counted, not caught up.
+// Every run of a task is timed under a latency stage named after it.
+
+#include <cerrno>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "instrumentation.h"
+
+struct ScheduledTask {
+    const char* name;
+    int fd;
+    std::chrono::nanoseconds interval;
+    std::function<void()> run;
+    unsigned long long ticks;
+    unsigned long long missed;
+    int stage;
+};
+
+class SampleScheduler {
+public:
+    SampleScheduler() : epfd_(epoll_create1(EPOLL_CLOEXEC)), stopped_(false) {
+        if (epfd_ < 0)
+            std::cerr << "Error: Unable to create epoll instance." << std::endl;
+    }
+
+    ~SampleScheduler() {
+        for (size_t i = 0; i < tasks_.size(); ++i)
+            close(tasks_[i].fd);
+        if (epfd_ >= 0)
+            close(epfd_);
+    }
+
+    SampleScheduler(const SampleScheduler&) = delete;
+    SampleScheduler& operator=(const SampleScheduler&) = delete;
+
+    // Returns the task id, or -1 if the timer could not be created.
+    int add(const char* name, std::chrono::nanoseconds interval, std::function<void()> run) {
+        if (epfd_ < 0 || interval.count() <= 0)
+            return -1;
+        int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "Error: Unable to create timer for " << name << "." << std::endl;
+            return -1;
+        }
+
+        int id = static_cast<int>(tasks_.size());
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = static_cast<unsigned>(id);
+        if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            return -1;
+        }
+
+        ScheduledTask task = {name, fd, interval, run, 0, 0, stageRegistry().stage(name)};
+        tasks_.push_back(task);
+        return id;
+    }
+
+    const ScheduledTask& task(int id) const { return tasks_[id]; }
+    size_t size() const { return tasks_.size(); }
+
+    // Arms every timer from the same epoch and dispatches expirations until
+    // stop() is called from inside a task.
+    bool run() {
+        struct timespec epoch;
+        clock_gettime(CLOCK_MONOTONIC, &epoch);
+        for (size_t i = 0; i < tasks_.size(); ++i) {
+            if (!arm(tasks_[i], epoch))
+                return false;
+        }
+
+        struct epoll_event events[16];
+        while (!stopped_) {
+            int n = epoll_wait(epfd_, events, 16, -1);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                std::cerr << "Error: epoll_wait failed." << std::endl;
+                return false;
+            }
+            for (int i = 0; i < n && !stopped_; ++i)
+                dispatch(tasks_[events[i].data.u32]);
+        }
+        return true;
+    }
+
+    void stop() { stopped_ = true; }
+
+private:
+    static bool arm(const ScheduledTask& task, const struct timespec& epoch) {
+        long long ns = task.interval.count();
+        struct itimerspec spec;
+        spec.it_interval.tv_sec = static_cast<time_t>(ns / 1000000000LL);
+        spec.it_interval.tv_nsec = static_cast<long>(ns % 1000000000LL);
+
+        // The first deadline is the epoch itself, so slow metrics (e.g. disk
+        // every 30s) have a value from the start.
+        spec.it_value = epoch;
+
+        if (timerfd_settime(task.fd, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+            std::cerr << "Error: Unable to arm timer for " << task.name << "." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    static void dispatch(ScheduledTask& task) {
+        unsigned long long expirations = 0;
+        if (read(task.fd, &expirations, sizeof(expirations)) != sizeof(expirations) || expirations == 0)
+            return;
+        task.ticks += expirations;
+        task.missed += expirations - 1;
+        ScopedStageTimer timer(task.stage);
+        task.run();
+    }
+
+    int epfd_;
+    bool stopped_;
+    std::vector<ScheduledTask> tasks_;
+};
+
+#endif
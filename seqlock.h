@@ -0,0 +1,75 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+// Single-writer / multi-reader snapshot of a trivially copyable value.
+// The writer never waits; readers retry only if a write overlapped their
+// copy, so they always see a value that was published as a whole.
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SEQLOCK_PAUSE() _mm_pause()
+#else
+#define SEQLOCK_PAUSE() ((void)0)
+#endif
+
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock needs a trivially copyable type");
+
+public:
+    Seqlock() : seq_(0) {
+        T zero;
+        std::memset(&zero, 0, sizeof(zero));
+        store(zero);
+    }
+
+    explicit Seqlock(const T& value) : seq_(0) { store(value); }
+
+    // Only one thread may call store() on a given instance.
+    void store(const T& value) {
+        unsigned long long words[kWords] = {};
+        std::memcpy(words, &value, sizeof(T));
+
+        unsigned long long seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < kWords; ++i)
+            data_[i].store(words[i], std::memory_order_relaxed);
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        unsigned long long words[kWords];
+        unsigned long long before, after;
+        do {
+            before = seq_.load(std::memory_order_acquire);
+            if (before & 1) {
+                SEQLOCK_PAUSE();
+                continue;
+            }
+            for (size_t i = 0; i < kWords; ++i)
+                words[i] = data_[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = seq_.load(std::memory_order_relaxed);
+            if (before == after)
+                break;
+        } while (true);
+
+        T value;
+        std::memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+private:
+    static const size_t kWords = (sizeof(T) + sizeof(unsigned long long) - 1) / sizeof(unsigned long long);
+
+    // Aligned so a snapshot does not share a cache line with unrelated data.
+    alignas(64) std::atomic<unsigned long long> seq_;
+    std::atomic<unsigned long long> data_[kWords];
+};
+
+#endif
@@ -1,76 +1,25 @@
+#include <csignal>
+#include <cstdio>
 #include <iostream>
-#include <Windows.h>
+#include <string>
 #include <thread>
 #include <vector>
 
-using namespace std;
-
-struct UsageStats {
-    double currentUsage;
-    double maxUsage;
-    double totalUsage;
-    int count;
-};
-
-void clearScreen() {
-    system("cls");
-}
-
-double getCPUUsage() {
-    FILETIME idleTime, kernelTime, userTime;
-
-    if (!GetSystemTimes(&idleTime, &kernelTime, &userTime)) {
-        cerr << "Error: Unable to get system times." << endl;
-        return -1.0;
-    }
-
-    static ULONGLONG prevIdleTime = 0, prevKernelTime = 0, prevUserTime = 0;
-    ULONGLONG idleTimeNow = (reinterpret_cast<ULONGLONG*>(&idleTime))[0];
-    ULONGLONG kernelTimeNow = (reinterpret_cast<ULONGLONG*>(&kernelTime))[0];
-    ULONGLONG userTimeNow = (reinterpret_cast<ULONGLONG*>(&userTime))[0];
-
-    double idle = idleTimeNow - prevIdleTime;
-    double kernel = kernelTimeNow - prevKernelTime;
-    double user = userTimeNow - prevUserTime;
-    double system = kernel + user;
+#include "monitor_core.h"
+#include "term_view.h"
 
-    double cpu_usage = ((system - idle) / system) * 100.0;
-
-    prevIdleTime = idleTimeNow;
-    prevKernelTime = kernelTimeNow;
-    prevUserTime = userTimeNow;
-
-    return cpu_usage;
-}
-
-double getRAMUsage() {
-    MEMORYSTATUSEX memoryStatus;
-    memoryStatus.dwLength = sizeof(memoryStatus);
-    GlobalMemoryStatusEx(&memoryStatus);
-
-    double totalRAM = memoryStatus.ullTotalPhys / (1024.0 * 1024.0); // Convert bytes to MB
-    double usedRAM = (memoryStatus.ullTotalPhys - memoryStatus.ullAvailPhys) / (1024.0 * 1024.0); // Convert bytes to MB
+using namespace std;
 
-    double ram_usage = (usedRAM / totalRAM) * 100.0;
+// Cleared by Ctrl-C so the view can restore the terminal on the way out.
+volatile sig_atomic_t running = 1;
 
-    return ram_usage;
+void stopRunning(int) {
+    running = 0;
 }
 
-double getDiskUsage() {
-    ULARGE_INTEGER freeBytesAvailable, totalNumberOfBytes, totalNumberOfFreeBytes;
-
-    if (!GetDiskFreeSpaceEx(NULL, &freeBytesAvailable, &totalNumberOfBytes, &totalNumberOfFreeBytes)) {
-        cerr << "Error: Unable to get disk space." << endl;
-        return -1.0;
-    }
-
-    double totalDiskSpace = totalNumberOfBytes.QuadPart / (1024.0 * 1024.0 * 1024.0); // Convert bytes to GB
-    double freeDiskSpace = totalNumberOfFreeBytes.QuadPart / (1024.0 * 1024.0 * 1024.0); // Convert bytes to GB
-
-    double disk_usage = ((totalDiskSpace - freeDiskSpace) / totalDiskSpace) * 100.0;
-
-    return disk_usage;
-}
+#ifndef _WIN32
+#include "cpu_cores.h"
+#endif
 
 string getCurrentTimestamp() {
     char buffer[80];
@@ -89,77 +38,101 @@ string getCurrentTimestamp() {
     return time_str + "\n" + date_location_str;
 }
 
-int main() {
-    // Initialize usage statistics for CPU, RAM, and Disk
-    UsageStats cpuStats = {0.0, 0.0, 0.0, 0};
-    UsageStats ramStats = {0.0, 0.0, 0.0, 0};
-    UsageStats diskStats = {0.0, 0.0, 0.0, 0};
-
-    // Vector to store historical usages for calculating average
-    vector<double> cpuHistory;
-    vector<double> ramHistory;
-    vector<double> diskHistory;
-
-    while (true) {
-        clearScreen();
-
-        double cpu_usage = getCPUUsage();
-        double ram_usage = getRAMUsage();
-        double disk_usage = getDiskUsage();
-
-        // Update current usage
-        cpuStats.currentUsage = cpu_usage;
-        ramStats.currentUsage = ram_usage;
-        diskStats.currentUsage = disk_usage;
-
-        // Update maximum usage
-        if (cpu_usage > cpuStats.maxUsage)
-            cpuStats.maxUsage = cpu_usage;
-        if (ram_usage > ramStats.maxUsage)
-            ramStats.maxUsage = ram_usage;
-        if (disk_usage > diskStats.maxUsage)
-            diskStats.maxUsage = disk_usage;
-
-        // Update total usage and count for average calculation
-        cpuStats.totalUsage += cpu_usage;
-        ramStats.totalUsage += ram_usage;
-        diskStats.totalUsage += disk_usage;
-        cpuStats.count++;
-        ramStats.count++;
-        diskStats.count++;
-
-        // Update history for average calculation
-        cpuHistory.push_back(cpu_usage);
-        ramHistory.push_back(ram_usage);
-        diskHistory.push_back(disk_usage);
-        
-        cout << "LIVE RESMON :->" << endl;
-        cout << "Timestamp: " << getCurrentTimestamp() << endl;
-        cout << endl;
-        cout << "Current CPU Usage: " << cpu_usage << "%" << endl;
-        cout << "Current RAM Usage: " << ram_usage << "%" << endl;
-        cout << "Current Disk Usage: " << disk_usage << "%" << endl;
-        cout << "--------------------------------------" << endl;
-
-        if (cpuStats.count != 0) {
-            double avgCPU = cpuStats.totalUsage / cpuStats.count;
-            cout << "Average CPU Usage: " << avgCPU << "%" << endl;
-        }
-        if (ramStats.count != 0) {
-            double avgRAM = ramStats.totalUsage / ramStats.count;
-            cout << "Average RAM Usage: " << avgRAM << "%" << endl;
-        }
-        if (diskStats.count != 0) {
-            double avgDisk = diskStats.totalUsage / diskStats.count;
-            cout << "Average Disk Usage: " << avgDisk << "%" << endl;
-        }
+// Up to `cells` of the newest samples, oldest first.
+void recentSamples(const MetricHistory& history, size_t cells, vector<double>& out) {
+    size_t n = min(cells, history.size());
+    out.resize(n);
+    for (size_t i = 0; i < n; ++i)
+        out[i] = history.recent(n - 1 - i);
+}
+
+// "CPU  [bar] 12.3%  avg 5.0%  max 40.0%  [sparkline to the right edge]"
+void drawMetric(TerminalView& view, int row, const char* label, const UsageStats& stats, const MetricHistory& history,
+                vector<double>& scratch) {
+    char buf[64];
+    double avg = averageUsage(stats);
+    view.text(row, 0, label, TERM_CYAN);
+    int col = view.bar(row, 6, 20, stats.currentUsage, usageColor(stats.currentUsage));
+    snprintf(buf, sizeof(buf), " %5.1f%%  avg %5.1f%%  max %5.1f%%  ", stats.currentUsage, avg, stats.maxUsage);
+    col = view.text(row, col, buf);
+    recentSamples(history, col < view.width() ? static_cast<size_t>(view.width() - col) : 0, scratch);
+    view.sparkline(row, col, scratch, usageColor(stats.currentUsage));
+}
 
-        cout << "--------------------------------------" << endl;
-        cout << "Max CPU Usage: " << cpuStats.maxUsage << "%" << endl;
-        cout << "Max RAM Usage: " << ramStats.maxUsage << "%" << endl;
-        cout << "Max Disk Usage: " << diskStats.maxUsage << "%" << endl;
+// "CPU  1m 3.0% (0.0-10.0)  5m ...  15m ..."
+void drawWindows(TerminalView& view, int row, const char* label, const LoadWindows& windows) {
+    const size_t ids[3] = {windows.oneMinute, windows.fiveMinutes, windows.fifteenMinutes};
+    const char* names[3] = {"1m", "5m", "15m"};
+    view.text(row, 0, label, TERM_CYAN);
+    int col = 6;
+    for (int i = 0; i < 3; ++i) {
+        WindowSummary w = windows.history.summary(ids[i]);
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%-3s %5.1f%% (%.1f-%.1f)  ", names[i], w.average, w.min, w.max);
+        col = view.text(row, col, buf);
+    }
+}
 
-        this_thread::sleep_for(chrono::seconds(1));
+// Draws the whole live view once per tick.
+struct LiveViewSink {
+    TerminalView view;
+    vector<double> scratch;
+#ifndef _WIN32
+    CoreSampler coreSampler;
+    CoreUsageTable cores;
+    vector<MetricHistory> coreHistory;
+
+    LiveViewSink() : coreHistory(coreSampler.cores(), MetricHistory(512)) {}
+#endif
+
+    template <typename Core>
+    void write(const Core& core) {
+        view.begin();
+        string timestamp = getCurrentTimestamp();
+        timestamp.replace(timestamp.find('\n'), 1, "  ");
+        int col = view.text(0, 0, "LIVE RESMON :->  ", TERM_CYAN);
+        view.text(0, col, timestamp);
+
+        int row = 2;
+        core.forEach([&](const char* label, const char*, const MetricState& m) {
+            drawMetric(view, row++, label, m.stats, m.windows.history, scratch);
+        });
+        ++row;
+        core.forEach([&](const char* label, const char*, const MetricState& m) {
+            drawWindows(view, row++, label, m.windows);
+        });
+        ++row;
+
+#ifndef _WIN32
+        if (coreSampler.sample(cores)) {
+            for (int i = 0; i < cores.cores; ++i)
+                coreHistory[i].push(cores.busy[i]);
+            view.text(row++, 0, "Core                        busy  user   sys iowait steal   irq", TERM_CYAN);
+            for (int i = 0; i < cores.cores && row < view.height(); ++i, ++row) {
+                char buf[64];
+                snprintf(buf, sizeof(buf), "%4d ", i);
+                int c = view.text(row, 0, buf);
+                c = view.bar(row, c, 20, cores.busy[i], usageColor(cores.busy[i]));
+                snprintf(buf, sizeof(buf), " %5.1f%% %5.1f %5.1f %6.1f %5.1f %5.1f  ", cores.busy[i], cores.user[i],
+                         cores.system[i], cores.iowait[i], cores.steal[i], cores.irq[i]);
+                c = view.text(row, c, buf);
+                recentSamples(coreHistory[i], c < view.width() ? static_cast<size_t>(view.width() - c) : 0, scratch);
+                view.sparkline(row, c, scratch, usageColor(cores.busy[i]));
+            }
+        }
+#endif
+        view.present();
     }
+};
+
+int main() {
+    // Bounded history with 1m/5m/15m windows, sampled once per second
+    MonitorCore<CpuCollector, RamCollector, DiskCollector> core(chrono::seconds(1));
+
+    signal(SIGINT, stopRunning);
+    signal(SIGTERM, stopRunning);
+    LiveViewSink liveView;
+
+    runMonitor(core, chrono::seconds(1), running, liveView);
     return 0;
 }
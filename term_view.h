@@ -0,0 +1,240 @@
+#ifndef TERM_VIEW_H
+#define TERM_VIEW_H
+
+// Differential terminal renderer for the live views.
+//
+// A frame is drawn into a back buffer of cells; present() compares it with
+// the front buffer (what the terminal currently shows) and emits ANSI
+// escape sequences for the changed cells only, as one write. The window
+// size is re-read at the start of every frame, and a size change repaints
+// the whole screen once. Nothing is cleared between frames, so there is no
+// flicker, and no process is ever spawned.
+//
+// The view runs on the alternate screen with the cursor hidden; both are
+// restored when the view is destroyed.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+enum TermColor { TERM_DEFAULT, TERM_GREEN, TERM_YELLOW, TERM_RED, TERM_CYAN, TERM_DIM };
+
+class TerminalView {
+public:
+    TerminalView() : width_(0), height_(0), repaint_(true) {
+#ifdef _WIN32
+        HANDLE out = GetStdHandle(STD_OUTPUT_HANDLE);
+        DWORD mode = 0;
+        if (GetConsoleMode(out, &mode))
+            SetConsoleMode(out, mode | 0x0004); // ENABLE_VIRTUAL_TERMINAL_PROCESSING
+        SetConsoleOutputCP(CP_UTF8);
+#endif
+        emit("\033[?1049h\033[?25l");
+    }
+
+    ~TerminalView() { emit("\033[0m\033[?25h\033[?1049l"); }
+
+    TerminalView(const TerminalView&) = delete;
+    TerminalView& operator=(const TerminalView&) = delete;
+
+    // Starts a frame: picks up the current window size and blanks the back
+    // buffer.
+    void begin() {
+        int w = 80, h = 24;
+        querySize(w, h);
+        if (w != width_ || h != height_) {
+            width_ = w;
+            height_ = h;
+            back_.assign(static_cast<size_t>(w) * h, Cell());
+            front_.assign(back_.size(), Cell());
+            repaint_ = true;
+        } else {
+            std::fill(back_.begin(), back_.end(), Cell());
+        }
+    }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // Draws ASCII text; returns the column after it. Clipped at the edge.
+    int text(int row, int col, const std::string& s, TermColor color = TERM_DEFAULT) {
+        for (size_t i = 0; i < s.size(); ++i, ++col) {
+            if (s[i] == '\n')
+                break;
+            put(row, col, static_cast<unsigned char>(s[i]), color);
+        }
+        return col;
+    }
+
+    // Horizontal bar of `cells` cells filled to percent, in eighths of a cell.
+    int bar(int row, int col, int cells, double percent, TermColor color) {
+        double filled = clampPercent(percent) / 100.0 * cells;
+        for (int i = 0; i < cells; ++i) {
+            double part = filled - i;
+            int eighths = part >= 1.0 ? 8 : (part > 0.0 ? static_cast<int>(part * 8.0) : 0);
+            if (eighths > 0)
+                put(row, col + i, blockGlyph(0x90 - eighths), color); // U+2588 full .. U+258F one eighth
+            else
+                put(row, col + i, blockGlyph(0x91), TERM_DIM); // U+2591 light shade
+        }
+        return col + cells;
+    }
+
+    // One cell per value, oldest first, scaled to 0..100%.
+    int sparkline(int row, int col, const std::vector<double>& values, TermColor color) {
+        for (size_t i = 0; i < values.size(); ++i) {
+            int level = static_cast<int>(clampPercent(values[i]) / 100.0 * 7.0 + 0.5);
+            put(row, col + static_cast<int>(i), blockGlyph(0x81 + level), color); // U+2581 .. U+2588
+        }
+        return col + static_cast<int>(values.size());
+    }
+
+    // Emits the difference between the back and front buffers in one write.
+    void present() {
+        out_.clear();
+        if (repaint_) {
+            // The front buffer was blanked on resize, which matches the
+            // cleared screen.
+            out_.append("\033[0m\033[2J");
+            repaint_ = false;
+        }
+
+        int curRow = -1, curCol = -1;
+        int curColor = -1;
+        for (int r = 0; r < height_; ++r) {
+            for (int c = 0; c < width_; ++c) {
+                size_t i = static_cast<size_t>(r) * width_ + c;
+                const Cell& cell = back_[i];
+                if (cell == front_[i])
+                    continue;
+                // The last cell can scroll some terminals; leave it alone.
+                if (r == height_ - 1 && c == width_ - 1)
+                    continue;
+                if (r == curRow && c > curCol && c - curCol <= kMaxGap) {
+                    // Re-sending a few unchanged cells is shorter than a
+                    // cursor move.
+                    for (int g = curCol; g < c; ++g)
+                        emitCell(back_[i - (c - g)], curColor);
+                } else if (r != curRow || c != curCol) {
+                    char move[32];
+                    snprintf(move, sizeof(move), "\033[%d;%dH", r + 1, c + 1);
+                    out_.append(move);
+                }
+                emitCell(cell, curColor);
+                front_[i] = cell;
+                curRow = r;
+                curCol = c + 1;
+            }
+        }
+        if (!out_.empty()) {
+            out_.append("\033[0m");
+            emit(out_);
+        }
+    }
+
+    // Bytes written by the last present(), for the cost-conscious.
+    size_t lastFrameBytes() const { return out_.size(); }
+
+private:
+    static const int kMaxGap = 4;
+
+    struct Cell {
+        uint32_t glyph; // UTF-8 bytes, first byte lowest
+        uint8_t color;
+
+        Cell() : glyph(' '), color(TERM_DEFAULT) {}
+        bool operator==(const Cell& o) const { return glyph == o.glyph && color == o.color; }
+    };
+
+    // Block Elements U+2580..U+259F are E2 96 xx in UTF-8.
+    static uint32_t blockGlyph(int last) { return 0xe2u | 0x96u << 8 | static_cast<uint32_t>(last) << 16; }
+
+    static const char* colorSequence(int color) {
+        static const char* const sequences[6] = {"\033[0m", "\033[0;32m", "\033[0;33m",
+                                                 "\033[0;31m", "\033[0;36m", "\033[0;2m"};
+        return sequences[color];
+    }
+
+    static double clampPercent(double v) { return v != v || v < 0.0 ? 0.0 : (v > 100.0 ? 100.0 : v); }
+
+    void put(int row, int col, uint32_t glyph, TermColor color) {
+        if (row < 0 || row >= height_ || col < 0 || col >= width_)
+            return;
+        Cell& cell = back_[static_cast<size_t>(row) * width_ + col];
+        cell.glyph = glyph;
+        cell.color = static_cast<uint8_t>(color);
+    }
+
+    void emitCell(const Cell& cell, int& curColor) {
+        if (cell.color != curColor) {
+            out_.append(colorSequence(cell.color));
+            curColor = cell.color;
+        }
+        appendGlyph(cell.glyph);
+    }
+
+    void appendGlyph(uint32_t g) {
+        do {
+            out_.push_back(static_cast<char>(g & 0xff));
+            g >>= 8;
+        } while (g);
+    }
+
+    static void querySize(int& w, int& h) {
+#ifdef _WIN32
+        CONSOLE_SCREEN_BUFFER_INFO info;
+        if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) {
+            w = info.srWindow.Right - info.srWindow.Left + 1;
+            h = info.srWindow.Bottom - info.srWindow.Top + 1;
+        }
+#else
+        struct winsize ws;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 && ws.ws_row > 0) {
+            w = ws.ws_col;
+            h = ws.ws_row;
+        }
+#endif
+    }
+
+    static void emit(const std::string& s) {
+        const char* p = s.data();
+        size_t left = s.size();
+        while (left > 0) {
+#ifdef _WIN32
+            DWORD n = 0;
+            if (!WriteFile(GetStdHandle(STD_OUTPUT_HANDLE), p, static_cast<DWORD>(left), &n, NULL) || n == 0)
+                return;
+#else
+            ssize_t n = write(STDOUT_FILENO, p, left);
+            if (n <= 0)
+                return;
+#endif
+            p += n;
+            left -= static_cast<size_t>(n);
+        }
+    }
+
+    int width_;
+    int height_;
+    bool repaint_;
+    std::vector<Cell> back_;
+    std::vector<Cell> front_;
+    std::string out_;
+};
+
+// Green below 50%, yellow below 80%, red above.
+inline TermColor usageColor(double percent) {
+    return percent < 50.0 ? TERM_GREEN : (percent < 80.0 ? TERM_YELLOW : TERM_RED);
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef WIN_BACKEND_H
+#define WIN_BACKEND_H
+
+// Windows backend for getCPUUsage / getRAMUsage / getDiskUsage, the
+// counterpart of proc_backend.h.
+
+#include <iostream>
+#include <Windows.h>
+
+inline bool getCPUUsage(double& cpu_usage) {
+    FILETIME idleTime, kernelTime, userTime;
+
+    if (!GetSystemTimes(&idleTime, &kernelTime, &userTime)) {
+        std::cerr << "Error: Unable to get system times." << std::endl;
+        return false;
+    }
+
+    static ULONGLONG prevIdleTime = 0, prevKernelTime = 0, prevUserTime = 0;
+    ULONGLONG idleTimeNow = (reinterpret_cast<ULONGLONG*>(&idleTime))[0];
+    ULONGLONG kernelTimeNow = (reinterpret_cast<ULONGLONG*>(&kernelTime))[0];
+    ULONGLONG userTimeNow = (reinterpret_cast<ULONGLONG*>(&userTime))[0];
+
+    double idle = idleTimeNow - prevIdleTime;
+    double kernel = kernelTimeNow - prevKernelTime;
+    double user = userTimeNow - prevUserTime;
+    double system = kernel + user;
+
+    cpu_usage = ((system - idle) / system) * 100.0;
+
+    prevIdleTime = idleTimeNow;
+    prevKernelTime = kernelTimeNow;
+    prevUserTime = userTimeNow;
+
+    return true;
+}
+
+inline bool getRAMUsage(double& ram_usage) {
+    MEMORYSTATUSEX memoryStatus;
+    memoryStatus.dwLength = sizeof(memoryStatus);
+    if (!GlobalMemoryStatusEx(&memoryStatus)) {
+        std::cerr << "Error: Unable to get memory status." << std::endl;
+        return false;
+    }
+
+    double totalRAM = memoryStatus.ullTotalPhys / (1024.0 * 1024.0); // Convert bytes to MB
+    double usedRAM = (memoryStatus.ullTotalPhys - memoryStatus.ullAvailPhys) / (1024.0 * 1024.0); // Convert bytes to MB
+
+    ram_usage = (usedRAM / totalRAM) * 100.0;
+
+    return true;
+}
+
+inline bool getDiskUsage(double& disk_usage) {
+    ULARGE_INTEGER freeBytesAvailable, totalNumberOfBytes, totalNumberOfFreeBytes;
+
+    if (!GetDiskFreeSpaceEx(NULL, &freeBytesAvailable, &totalNumberOfBytes, &totalNumberOfFreeBytes)) {
+        std::cerr << "Error: Unable to get disk space." << std::endl;
+        return false;
+    }
+
+    double totalDiskSpace = totalNumberOfBytes.QuadPart / (1024.0 * 1024.0 * 1024.0); // Convert bytes to GB
+    double freeDiskSpace = totalNumberOfFreeBytes.QuadPart / (1024.0 * 1024.0 * 1024.0); // Convert bytes to GB
+
+    disk_usage = ((totalDiskSpace - freeDiskSpace) / totalDiskSpace) * 100.0;
+
+    return true;
+}
+#endif
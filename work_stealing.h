@@ -0,0 +1,187 @@
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H
+
+// Persistent work-stealing thread pool for chunked ranges.
+//
+// run(chunks, body) calls body(worker, chunk) once for every chunk index in
+// [0, chunks). The pool's threads are started once and sleep between runs;
+// the calling thread takes part as worker 0, so a pool of N workers starts
+// N - 1 threads. Each worker owns a deque of chunk indices, seeded with an
+// equal contiguous share. The owner pops from the front; a worker whose
+// deque is empty steals the back half of the fullest other deque and
+// carries on from there, so workers that got cheap chunks take load off
+// the ones that got expensive chunks and nobody idles while work is left.
+// A deque is always a contiguous run of indices, so it is stored as a
+// [front, back) pair under a per-worker lock that is held for a few
+// instructions. A worker stops when every deque is empty; run() returns
+// once all of them have stopped.
+//
+// The pool gives no way to combine results: bodies write to per-worker
+// slots indexed by `worker`, which the caller reads after run() returns
+// (run() is a full barrier), so the reduction takes no lock.
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool {
+public:
+    typedef std::function<void(unsigned worker, uint64_t chunk)> Body;
+
+    explicit WorkStealingPool(unsigned workers)
+        : size_(workers > 0 ? workers : 1), queues_(new Queue[size_]), body_(nullptr), active_(0), generation_(0),
+          running_(0), stop_(false) {
+        for (unsigned w = 1; w < size_; ++w)
+            threads_.push_back(std::thread(&WorkStealingPool::threadMain, this, w));
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (size_t i = 0; i < threads_.size(); ++i)
+            threads_[i].join();
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const { return size_; }
+
+    // Runs body on every chunk using the first `workers` workers (0 or more
+    // than size() means all of them) and returns when every chunk is done.
+    // Not reentrant: call from one thread at a time.
+    void run(uint64_t chunks, const Body& body, unsigned workers = 0) {
+        unsigned active = workers == 0 || workers > size_ ? size_ : workers;
+        for (unsigned w = 0; w < size_; ++w) {
+            Queue& q = queues_[w];
+            q.front = w < active ? chunks * w / active : 0;
+            q.back = w < active ? chunks * (w + 1) / active : 0;
+            q.steals = 0;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            body_ = &body;
+            active_ = active;
+            running_ = active - 1;
+            ++generation_;
+        }
+        if (active > 1)
+            wake_.notify_all();
+        work(0);
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return running_ == 0; });
+        body_ = nullptr;
+    }
+
+    // Chunks taken from other workers' deques during the last run.
+    uint64_t steals() const {
+        uint64_t total = 0;
+        for (unsigned w = 0; w < size_; ++w)
+            total += queues_[w].steals;
+        return total;
+    }
+
+private:
+    struct Queue {
+        std::mutex lock;
+        uint64_t front;
+        uint64_t back;
+        uint64_t steals; // chunks this worker stole, written only by it
+        char pad[64];    // keeps neighbouring workers' queues off this cache line
+
+        Queue() : front(0), back(0), steals(0) {}
+    };
+
+    void threadMain(unsigned w) {
+        uint64_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stop_ || (generation_ != seen && w < active_); });
+                if (stop_)
+                    return;
+                seen = generation_;
+            }
+            work(w);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--running_ == 0)
+                done_.notify_one();
+        }
+    }
+
+    void work(unsigned w) {
+        const Body& body = *body_;
+        uint64_t chunk;
+        while (pop(w, chunk) || (steal(w) && pop(w, chunk)))
+            body(w, chunk);
+    }
+
+    bool pop(unsigned w, uint64_t& chunk) {
+        Queue& q = queues_[w];
+        std::lock_guard<std::mutex> lock(q.lock);
+        if (q.front == q.back)
+            return false;
+        chunk = q.front++;
+        return true;
+    }
+
+    // Moves the back half of the fullest other deque into w's (empty) one.
+    // Deques only shrink during a run, so once every one is empty it stays
+    // that way and the worker can stop.
+    bool steal(unsigned w) {
+        for (;;) {
+            unsigned victim = w;
+            uint64_t most = 0;
+            for (unsigned i = 1; i < active_; ++i) {
+                unsigned v = (w + i) % active_;
+                Queue& q = queues_[v];
+                std::lock_guard<std::mutex> lock(q.lock);
+                if (q.back - q.front > most) {
+                    most = q.back - q.front;
+                    victim = v;
+                }
+            }
+            if (victim == w)
+                return false;
+
+            uint64_t front, back;
+            {
+                Queue& q = queues_[victim];
+                std::lock_guard<std::mutex> lock(q.lock);
+                if (q.front == q.back)
+                    continue; // drained meanwhile; look again
+                back = q.back;
+                front = q.back - (q.back - q.front + 1) / 2;
+                q.back = front;
+            }
+            Queue& mine = queues_[w];
+            std::lock_guard<std::mutex> lock(mine.lock);
+            mine.front = front;
+            mine.back = back;
+            mine.steals += back - front;
+            return true;
+        }
+    }
+
+    unsigned size_;
+    std::unique_ptr<Queue[]> queues_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_; // guards the fields below
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const Body* body_;
+    unsigned active_;
+    uint64_t generation_;
+    unsigned running_; // started workers other than 0 still working
+    bool stop_;
+};
+
+#endif